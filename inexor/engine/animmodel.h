@@ -853,7 +853,7 @@ struct animmodel : model
                 glPopMatrix();
             }
 
-            if(!(anim&ANIM_REUSE)) 
+            if(!(anim&ANIM_REUSE) && !prepass) 
             {
                 loopv(links)
                 {
@@ -1277,6 +1277,7 @@ struct animmodel : model
         center.add(radius);
     }
 
+    static bool prepass;
     static bool enabletc, enablemtc, enablealphatest, enablealphablend, enableenvmap, enableglow, enableoverbright, enablelighting, enablelight0, enablecullface, enablenormals, enabletangents, enablebones, enablerescale, enabledepthoffset;
     static vec lightdir, lightcolor;
     static float transparent, lastalphatest;
@@ -1406,6 +1407,7 @@ struct animmodel : model
     }
 };
 
+bool animmodel::prepass = false;
 bool animmodel::enabletc = false, animmodel::enablemtc = false, animmodel::enablealphatest = false, animmodel::enablealphablend = false,
      animmodel::enableenvmap = false, animmodel::enableglow = false, animmodel::enableoverbright = false, animmodel::enablelighting = false, animmodel::enablelight0 = false, animmodel::enablecullface = true,
      animmodel::enablenormals = false, animmodel::enabletangents = false, animmodel::enablebones = false, animmodel::enablerescale = false, animmodel::enabledepthoffset = false;
@@ -28,6 +28,246 @@ VARFP(maxdecaltris, 1, 1024, 16384, initdecals());
 VARP(decalfade, 1000, 10000, 60000);
 VAR(dbgdec, 0, 0, 1);
 
+struct decalrenderer;
+
+// a decal waiting to be clipped against the world, which only reads the octree and so is done on the job threads
+struct decalclip
+{
+    decalrenderer *owner;
+    int flags;
+    bvec color;
+    ivec bbmin, bbmax;
+    vec decalcenter, decalnormal, decaltangent, decalbitangent;
+    float decalradius, decalu, decalv;
+    bvec4 decalcolor;
+    vector<decalvert> verts;
+    vector<int> faces; // number of verts each clipped face added
+
+    static int clip(const vec *in, int numin, const vec &dir, float below, float above, vec *out)
+    {
+        int numout = 0;
+        const vec *p = &in[numin-1];
+        float pc = dir.dot(*p);
+        loopi(numin)
+        {
+            const vec &v = in[i];
+            float c = dir.dot(v);
+            if(c < below)
+            {
+                if(pc > above) out[numout++] = vec(*p).sub(v).mul((above - c)/(pc - c)).add(v);
+                if(pc > below) out[numout++] = vec(*p).sub(v).mul((below - c)/(pc - c)).add(v);
+            }
+            else if(c > above)
+            {
+                if(pc < below) out[numout++] = vec(*p).sub(v).mul((below - c)/(pc - c)).add(v);
+                if(pc < above) out[numout++] = vec(*p).sub(v).mul((above - c)/(pc - c)).add(v);
+            }
+            else
+            {
+                if(pc < below)
+                {
+                    if(c > below) out[numout++] = vec(*p).sub(v).mul((below - c)/(pc - c)).add(v);
+                }
+                else if(pc > above && c < above) out[numout++] = vec(*p).sub(v).mul((above - c)/(pc - c)).add(v);
+                out[numout++] = v;
+            }
+            p = &v;
+            pc = c;
+        }
+        return numout;
+    }
+
+    void gentris(cube &cu, int orient, const ivec &o, int size, materialsurface *mat = NULL, int vismask = 0)
+    {
+        vec pos[MAXFACEVERTS+4];
+        int numverts = 0, numplanes = 1;
+        vec planes[2];
+        if(mat)
+        {
+            planes[0] = vec(0, 0, 0);
+            switch(orient)
+            {
+            #define GENFACEORIENT(orient, v0, v1, v2, v3) \
+                case orient: \
+                    planes[0][dimension(orient)] = dimcoord(orient) ? 1 : -1; \
+                    v0 v1 v2 v3 \
+                    break;
+            #define GENFACEVERT(orient, vert, x,y,z, xv,yv,zv) \
+                    pos[numverts++] = vec(x xv, y yv, z zv);
+                GENFACEVERTS(o.x, o.x, o.y, o.y, o.z, o.z, , + mat->csize, , + mat->rsize, + 0.1f, - 0.1f);
+            #undef GENFACEORIENT
+            #undef GENFACEVERT 
+            }
+        }
+        else if(cu.texture[orient] == DEFAULT_SKY) return;
+        else if(cu.ext && (numverts = cu.ext->surfaces[orient].numverts&MAXFACEVERTS))
+        {
+            vertinfo *verts = cu.ext->verts() + cu.ext->surfaces[orient].verts;
+            ivec vo = ivec(o).mask(~0xFFF).shl(3);
+            loopj(numverts) pos[j] = verts[j].getxyz().add(vo).tovec().mul(1/8.0f);
+            planes[0].cross(pos[0], pos[1], pos[2]).normalize();
+            if(numverts >= 4 && !(cu.merged&(1<<orient)) && !flataxisface(cu, orient) && faceconvexity(verts, numverts, size))
+            {
+                planes[1].cross(pos[0], pos[2], pos[3]).normalize();
+                numplanes++;
+            }
+        }
+        else if(cu.merged&(1<<orient)) return;
+        else if(!vismask || (vismask&0x40 && visibleface(cu, orient, o.x, o.y, o.z, size, MAT_AIR, (cu.material&MAT_ALPHA)^MAT_ALPHA, MAT_ALPHA)))
+        {
+            ivec v[4];
+            genfaceverts(cu, orient, v);
+            int vis = 3, convex = faceconvexity(v, vis), order = convex < 0 ? 1 : 0;
+            vec vo = o.tovec();
+            pos[numverts++] = v[order].tovec().mul(size/8.0f).add(vo);
+            if(vis&1) pos[numverts++] = v[order+1].tovec().mul(size/8.0f).add(vo);
+            pos[numverts++] = v[order+2].tovec().mul(size/8.0f).add(vo);
+            if(vis&2) pos[numverts++] = v[(order+3)&3].tovec().mul(size/8.0f).add(vo);
+            planes[0].cross(pos[0], pos[1], pos[2]).normalize();
+            if(convex) { planes[1].cross(pos[0], pos[2], pos[3]).normalize(); numplanes++; }
+        } 
+        else return;
+
+        loopl(numplanes)
+        {
+            const vec &n = planes[l];
+            float facing = n.dot(decalnormal);
+            if(facing <= 0) continue;
+            vec p = vec(pos[0]).sub(decalcenter);
+#if 0
+            // intersect ray along decal normal with plane
+            float dist = n.dot(p) / facing;
+            if(fabs(dist) > decalradius) continue;
+            vec pcenter = vec(decalnormal).mul(dist).add(decalcenter);
+#else
+            // travel back along plane normal from the decal center
+            float dist = n.dot(p);
+            if(fabs(dist) > decalradius) continue;
+            vec pcenter = vec(n).mul(dist).add(decalcenter);
+#endif
+            vec ft, fb;
+            ft.orthogonal(n);
+            ft.normalize();
+            fb.cross(ft, n);
+            vec pt = vec(ft).mul(ft.dot(decaltangent)).add(vec(fb).mul(fb.dot(decaltangent))).normalize(),
+                pb = vec(ft).mul(ft.dot(decalbitangent)).add(vec(fb).mul(fb.dot(decalbitangent))).normalize();
+            // orthonormalize projected bitangent to prevent streaking
+            pb.sub(vec(pt).mul(pt.dot(pb))).normalize();
+            vec v1[MAXFACEVERTS+4], v2[MAXFACEVERTS+4];
+            float ptc = pt.dot(pcenter), pbc = pb.dot(pcenter);
+            int numv;
+            if(numplanes >= 2)
+            {
+                if(l) { pos[1] = pos[2]; pos[2] = pos[3]; } 
+                numv = clip(pos, 3, pt, ptc - decalradius, ptc + decalradius, v1);
+            if(numv<3) continue;
+            }
+            else
+            {
+                numv = clip(pos, numverts, pt, ptc - decalradius, ptc + decalradius, v1);
+            if(numv<3) continue;
+            }
+            numv = clip(v1, numv, pb, pbc - decalradius, pbc + decalradius, v2);
+            if(numv<3) continue;
+            float tsz = flags&DF_RND4 ? 0.5f : 1.0f, scale = tsz*0.5f/decalradius,
+                  tu = decalu + tsz*0.5f - ptc*scale, tv = decalv + tsz*0.5f - pbc*scale;
+            pt.mul(scale); pb.mul(scale);
+            decalvert dv1 = { v2[0], pt.dot(v2[0]) + tu, pb.dot(v2[0]) + tv, decalcolor },
+                      dv2 = { v2[1], pt.dot(v2[1]) + tu, pb.dot(v2[1]) + tv, decalcolor };
+            faces.add(3*(numv-2));
+            loopk(numv-2)
+            {
+                verts.add(dv1);
+                verts.add(dv2);
+                dv2.pos = v2[k+2];
+                dv2.u = pt.dot(v2[k+2]) + tu;
+                dv2.v = pb.dot(v2[k+2]) + tv;
+                verts.add(dv2);
+            }
+        }
+    }
+
+    void findmaterials(vtxarray *va)
+    {
+        materialsurface *matbuf = va->matbuf;
+        int matsurfs = va->matsurfs;
+        loopi(matsurfs)
+        {
+            materialsurface &m = matbuf[i];
+            if(!isclipped(m.material&MATF_VOLUME)) { i += m.skip; continue; }
+            int dim = dimension(m.orient), dc = dimcoord(m.orient);
+            if(dc ? decalnormal[dim] <= 0 : decalnormal[dim] >= 0) { i += m.skip; continue; }
+            int c = C[dim], r = R[dim];
+            for(;;)
+            {
+                materialsurface &m = matbuf[i];
+                if(m.o[dim] >= bbmin[dim] && m.o[dim] <= bbmax[dim] &&
+                   m.o[c] + m.csize >= bbmin[c] && m.o[c] <= bbmax[c] &&
+                   m.o[r] + m.rsize >= bbmin[r] && m.o[r] <= bbmax[r])
+                {
+                    static cube dummy;
+                    gentris(dummy, m.orient, m.o, max(m.csize, m.rsize), &m); 
+                }
+                if(i+1 >= matsurfs) break;
+                materialsurface &n = matbuf[i+1];
+                if(n.material != m.material || n.orient != m.orient) break;
+                i++;
+            } 
+        }
+    }
+
+    void findescaped(cube *cu, const ivec &o, int size, int escaped)
+    {
+        loopi(8)
+        {
+            if(escaped&(1<<i)) 
+            {
+                ivec co(i, o.x, o.y, o.z, size);
+                if(cu[i].children) findescaped(cu[i].children, co, size>>1, cu[i].escaped);
+                else
+                {
+                    int vismask = cu[i].merged;
+                    if(vismask) loopj(6) if(vismask&(1<<j)) gentris(cu[i], j, co, size);
+                }
+            } 
+        }
+    }
+
+    void gentris(cube *cu, const ivec &o, int size, int escaped = 0)
+    {
+        int overlap = octaboxoverlap(o, size, bbmin, bbmax);
+        loopi(8) 
+        {
+            if(overlap&(1<<i))
+            {
+                ivec co(i, o.x, o.y, o.z, size);
+                if(cu[i].ext && cu[i].ext->va && cu[i].ext->va->matsurfs)
+                    findmaterials(cu[i].ext->va);
+                if(cu[i].children) gentris(cu[i].children, co, size>>1, cu[i].escaped);
+                else 
+                {
+                    int vismask = cu[i].visible;
+                    if(vismask&0xC0)
+                    {
+                        if(vismask&0x80) loopj(6) gentris(cu[i], j, co, size, NULL, vismask);
+                        else loopj(6) if(vismask&(1<<j)) gentris(cu[i], j, co, size);
+                    }
+                }
+            }
+            else if(escaped&(1<<i))
+            {
+                ivec co(i, o.x, o.y, o.z, size);
+                if(cu[i].children) findescaped(cu[i].children, co, size>>1, cu[i].escaped);
+                else
+                {
+                    int vismask = cu[i].merged;
+                    if(vismask) loopj(6) if(vismask&(1<<j)) gentris(cu[i], j, co, size);
+                }
+            }
+        }
+    }
+};
+
 struct decalrenderer
 {
     const char *texname;
@@ -43,8 +283,7 @@ struct decalrenderer
           fadeintime(fadeintime), fadeouttime(fadeouttime), timetolive(timetolive),
           tex(NULL),
           decals(NULL), maxdecals(0), startdecal(0), enddecal(0),
-          verts(NULL), maxverts(0), startvert(0), endvert(0), lastvert(0), availverts(0),
-          decalu(0), decalv(0)
+          verts(NULL), maxverts(0), startvert(0), endvert(0), lastvert(0), availverts(0)
     {
     }
 
@@ -296,38 +535,60 @@ struct decalrenderer
         return d;
     }
 
-    ivec bbmin, bbmax;
-    vec decalcenter, decalnormal, decaltangent, decalbitangent;
-    float decalradius, decalu, decalv;
-    bvec4 decalcolor;
-
-    void adddecal(const vec &center, const vec &dir, float radius, const bvec &color, int info)
+    void adddecal(decalclip &dc, const vec &center, const vec &dir, float radius, const bvec &color, int info)
     {
+        dc.owner = this;
+        dc.flags = flags;
+        dc.color = color;
+        dc.verts.setsize(0);
+        dc.faces.setsize(0);
+
         int bbradius = int(ceil(radius));
-        bbmin = ivec(center).sub(bbradius);
-        bbmax = ivec(center).add(bbradius);
+        dc.bbmin = ivec(center).sub(bbradius);
+        dc.bbmax = ivec(center).add(bbradius);
 
-        decalcolor = bvec4(color, 255);
-        decalcenter = center;
-        decalradius = radius;
-        decalnormal = dir;
+        dc.decalcolor = bvec4(color, 255);
+        dc.decalcenter = center;
+        dc.decalradius = radius;
+        dc.decalnormal = dir;
 #if 0
-        decaltangent.orthogonal(dir);
+        dc.decaltangent.orthogonal(dir);
 #else
-        decaltangent = vec(dir.z, -dir.x, dir.y);
-        decaltangent.sub(vec(dir).mul(decaltangent.dot(dir)));
+        dc.decaltangent = vec(dir.z, -dir.x, dir.y);
+        dc.decaltangent.sub(vec(dir).mul(dc.decaltangent.dot(dir)));
 #endif
-        if(flags&DF_ROTATE) decaltangent.rotate(rnd(360)*RAD, dir);
-        decaltangent.normalize();
-        decalbitangent.cross(decaltangent, dir);
+        if(flags&DF_ROTATE) dc.decaltangent.rotate(rnd(360)*RAD, dir);
+        dc.decaltangent.normalize();
+        dc.decalbitangent.cross(dc.decaltangent, dir);
+        dc.decalu = dc.decalv = 0;
         if(flags&DF_RND4)
         {
-            decalu = 0.5f*(info&1);
-            decalv = 0.5f*((info>>1)&1);
+            dc.decalu = 0.5f*(info&1);
+            dc.decalv = 0.5f*((info>>1)&1);
         }
+    }
 
+    void commitdecal(const decalclip &dc)
+    {
         lastvert = endvert;
-        gentris(worldroot, ivec(0, 0, 0), worldsize>>1);
+        const decalvert *face = dc.verts.getbuf();
+        loopv(dc.faces)
+        {
+            int totalverts = dc.faces[i];
+            const decalvert *src = face;
+            face += totalverts;
+            if(totalverts > maxverts-3) continue;
+            while(availverts < totalverts && freedecal());
+            if(availverts < totalverts) continue;
+            availverts -= totalverts;
+            for(int k = 0; k < totalverts; k += 3)
+            {
+                verts[endvert++] = src[k];
+                verts[endvert++] = src[k+1];
+                verts[endvert++] = src[k+2];
+                if(endvert>=maxverts) endvert = 0;
+            }
+        }
         if(dbgdec)
         {
             int nverts = endvert < lastvert ? endvert + maxverts - lastvert : endvert - lastvert;
@@ -336,242 +597,11 @@ struct decalrenderer
         if(endvert==lastvert) return;
 
         decalinfo &d = newdecal();
-        d.color = color;
+        d.color = dc.color;
         d.millis = lastmillis;
         d.startvert = lastvert;
         d.endvert = endvert;
     }
-
-    static int clip(const vec *in, int numin, const vec &dir, float below, float above, vec *out)
-    {
-        int numout = 0;
-        const vec *p = &in[numin-1];
-        float pc = dir.dot(*p);
-        loopi(numin)
-        {
-            const vec &v = in[i];
-            float c = dir.dot(v);
-            if(c < below)
-            {
-                if(pc > above) out[numout++] = vec(*p).sub(v).mul((above - c)/(pc - c)).add(v);
-                if(pc > below) out[numout++] = vec(*p).sub(v).mul((below - c)/(pc - c)).add(v);
-            }
-            else if(c > above)
-            {
-                if(pc < below) out[numout++] = vec(*p).sub(v).mul((below - c)/(pc - c)).add(v);
-                if(pc < above) out[numout++] = vec(*p).sub(v).mul((above - c)/(pc - c)).add(v);
-            }
-            else
-            {
-                if(pc < below)
-                {
-                    if(c > below) out[numout++] = vec(*p).sub(v).mul((below - c)/(pc - c)).add(v);
-                }
-                else if(pc > above && c < above) out[numout++] = vec(*p).sub(v).mul((above - c)/(pc - c)).add(v);
-                out[numout++] = v;
-            }
-            p = &v;
-            pc = c;
-        }
-        return numout;
-    }
-
-    void gentris(cube &cu, int orient, const ivec &o, int size, materialsurface *mat = NULL, int vismask = 0)
-    {
-        vec pos[MAXFACEVERTS+4];
-        int numverts = 0, numplanes = 1;
-        vec planes[2];
-        if(mat)
-        {
-            planes[0] = vec(0, 0, 0);
-            switch(orient)
-            {
-            #define GENFACEORIENT(orient, v0, v1, v2, v3) \
-                case orient: \
-                    planes[0][dimension(orient)] = dimcoord(orient) ? 1 : -1; \
-                    v0 v1 v2 v3 \
-                    break;
-            #define GENFACEVERT(orient, vert, x,y,z, xv,yv,zv) \
-                    pos[numverts++] = vec(x xv, y yv, z zv);
-                GENFACEVERTS(o.x, o.x, o.y, o.y, o.z, o.z, , + mat->csize, , + mat->rsize, + 0.1f, - 0.1f);
-            #undef GENFACEORIENT
-            #undef GENFACEVERT 
-            }
-        }
-        else if(cu.texture[orient] == DEFAULT_SKY) return;
-        else if(cu.ext && (numverts = cu.ext->surfaces[orient].numverts&MAXFACEVERTS))
-        {
-            vertinfo *verts = cu.ext->verts() + cu.ext->surfaces[orient].verts;
-            ivec vo = ivec(o).mask(~0xFFF).shl(3);
-            loopj(numverts) pos[j] = verts[j].getxyz().add(vo).tovec().mul(1/8.0f);
-            planes[0].cross(pos[0], pos[1], pos[2]).normalize();
-            if(numverts >= 4 && !(cu.merged&(1<<orient)) && !flataxisface(cu, orient) && faceconvexity(verts, numverts, size))
-            {
-                planes[1].cross(pos[0], pos[2], pos[3]).normalize();
-                numplanes++;
-            }
-        }
-        else if(cu.merged&(1<<orient)) return;
-        else if(!vismask || (vismask&0x40 && visibleface(cu, orient, o.x, o.y, o.z, size, MAT_AIR, (cu.material&MAT_ALPHA)^MAT_ALPHA, MAT_ALPHA)))
-        {
-            ivec v[4];
-            genfaceverts(cu, orient, v);
-            int vis = 3, convex = faceconvexity(v, vis), order = convex < 0 ? 1 : 0;
-            vec vo = o.tovec();
-            pos[numverts++] = v[order].tovec().mul(size/8.0f).add(vo);
-            if(vis&1) pos[numverts++] = v[order+1].tovec().mul(size/8.0f).add(vo);
-            pos[numverts++] = v[order+2].tovec().mul(size/8.0f).add(vo);
-            if(vis&2) pos[numverts++] = v[(order+3)&3].tovec().mul(size/8.0f).add(vo);
-            planes[0].cross(pos[0], pos[1], pos[2]).normalize();
-            if(convex) { planes[1].cross(pos[0], pos[2], pos[3]).normalize(); numplanes++; }
-        } 
-        else return;
-
-        loopl(numplanes)
-        {
-            const vec &n = planes[l];
-            float facing = n.dot(decalnormal);
-            if(facing <= 0) continue;
-            vec p = vec(pos[0]).sub(decalcenter);
-#if 0
-            // intersect ray along decal normal with plane
-            float dist = n.dot(p) / facing;
-            if(fabs(dist) > decalradius) continue;
-            vec pcenter = vec(decalnormal).mul(dist).add(decalcenter);
-#else
-            // travel back along plane normal from the decal center
-            float dist = n.dot(p);
-            if(fabs(dist) > decalradius) continue;
-            vec pcenter = vec(n).mul(dist).add(decalcenter);
-#endif
-            vec ft, fb;
-            ft.orthogonal(n);
-            ft.normalize();
-            fb.cross(ft, n);
-            vec pt = vec(ft).mul(ft.dot(decaltangent)).add(vec(fb).mul(fb.dot(decaltangent))).normalize(),
-                pb = vec(ft).mul(ft.dot(decalbitangent)).add(vec(fb).mul(fb.dot(decalbitangent))).normalize();
-            // orthonormalize projected bitangent to prevent streaking
-            pb.sub(vec(pt).mul(pt.dot(pb))).normalize();
-            vec v1[MAXFACEVERTS+4], v2[MAXFACEVERTS+4];
-            float ptc = pt.dot(pcenter), pbc = pb.dot(pcenter);
-            int numv;
-            if(numplanes >= 2)
-            {
-                if(l) { pos[1] = pos[2]; pos[2] = pos[3]; } 
-                numv = clip(pos, 3, pt, ptc - decalradius, ptc + decalradius, v1);
-            if(numv<3) continue;
-            }
-            else
-            {
-                numv = clip(pos, numverts, pt, ptc - decalradius, ptc + decalradius, v1);
-            if(numv<3) continue;
-            }
-            numv = clip(v1, numv, pb, pbc - decalradius, pbc + decalradius, v2);
-            if(numv<3) continue;
-            float tsz = flags&DF_RND4 ? 0.5f : 1.0f, scale = tsz*0.5f/decalradius,
-                  tu = decalu + tsz*0.5f - ptc*scale, tv = decalv + tsz*0.5f - pbc*scale;
-            pt.mul(scale); pb.mul(scale);
-            decalvert dv1 = { v2[0], pt.dot(v2[0]) + tu, pb.dot(v2[0]) + tv, decalcolor },
-                      dv2 = { v2[1], pt.dot(v2[1]) + tu, pb.dot(v2[1]) + tv, decalcolor };
-            int totalverts = 3*(numv-2);
-            if(totalverts > maxverts-3) return;
-            while(availverts < totalverts) 
-            {
-                if(!freedecal()) return;
-            }
-            availverts -= totalverts;
-            loopk(numv-2)
-            {
-                verts[endvert++] = dv1;
-                verts[endvert++] = dv2;
-                dv2.pos = v2[k+2];
-                dv2.u = pt.dot(v2[k+2]) + tu;
-                dv2.v = pb.dot(v2[k+2]) + tv;
-                verts[endvert++] = dv2;
-                if(endvert>=maxverts) endvert = 0;
-            }
-        }
-    }
-
-    void findmaterials(vtxarray *va)
-    {
-        materialsurface *matbuf = va->matbuf;
-        int matsurfs = va->matsurfs;
-        loopi(matsurfs)
-        {
-            materialsurface &m = matbuf[i];
-            if(!isclipped(m.material&MATF_VOLUME)) { i += m.skip; continue; }
-            int dim = dimension(m.orient), dc = dimcoord(m.orient);
-            if(dc ? decalnormal[dim] <= 0 : decalnormal[dim] >= 0) { i += m.skip; continue; }
-            int c = C[dim], r = R[dim];
-            for(;;)
-            {
-                materialsurface &m = matbuf[i];
-                if(m.o[dim] >= bbmin[dim] && m.o[dim] <= bbmax[dim] &&
-                   m.o[c] + m.csize >= bbmin[c] && m.o[c] <= bbmax[c] &&
-                   m.o[r] + m.rsize >= bbmin[r] && m.o[r] <= bbmax[r])
-                {
-                    static cube dummy;
-                    gentris(dummy, m.orient, m.o, max(m.csize, m.rsize), &m); 
-                }
-                if(i+1 >= matsurfs) break;
-                materialsurface &n = matbuf[i+1];
-                if(n.material != m.material || n.orient != m.orient) break;
-                i++;
-            } 
-        }
-    }
-
-    void findescaped(cube *cu, const ivec &o, int size, int escaped)
-    {
-        loopi(8)
-        {
-            if(escaped&(1<<i)) 
-            {
-                ivec co(i, o.x, o.y, o.z, size);
-                if(cu[i].children) findescaped(cu[i].children, co, size>>1, cu[i].escaped);
-                else
-                {
-                    int vismask = cu[i].merged;
-                    if(vismask) loopj(6) if(vismask&(1<<j)) gentris(cu[i], j, co, size);
-                }
-            } 
-        }
-    }
-
-    void gentris(cube *cu, const ivec &o, int size, int escaped = 0)
-    {
-        int overlap = octaboxoverlap(o, size, bbmin, bbmax);
-        loopi(8) 
-        {
-            if(overlap&(1<<i))
-            {
-                ivec co(i, o.x, o.y, o.z, size);
-                if(cu[i].ext && cu[i].ext->va && cu[i].ext->va->matsurfs)
-                    findmaterials(cu[i].ext->va);
-                if(cu[i].children) gentris(cu[i].children, co, size>>1, cu[i].escaped);
-                else 
-                {
-                    int vismask = cu[i].visible;
-                    if(vismask&0xC0)
-                    {
-                        if(vismask&0x80) loopj(6) gentris(cu[i], j, co, size, NULL, vismask);
-                        else loopj(6) if(vismask&(1<<j)) gentris(cu[i], j, co, size);
-                    }
-                }
-            }
-            else if(escaped&(1<<i))
-            {
-                ivec co(i, o.x, o.y, o.z, size);
-                if(cu[i].children) findescaped(cu[i].children, co, size>>1, cu[i].escaped);
-                else
-                {
-                    int vismask = cu[i].merged;
-                    if(vismask) loopj(6) if(vismask&(1<<j)) gentris(cu[i], j, co, size);
-                }
-            }
-        }
-    }
 };
 
 decalrenderer decals[] =
@@ -581,13 +611,35 @@ decalrenderer decals[] =
     decalrenderer("<grey><decal>media/particle/bullet.png", DF_OVERBRIGHT)
 };
 
+static vector<decalclip *> decalclips;
+static int numdecalclips = 0;
+
+#define MAXDECALCLIPS 256
+
+static void clipdecal(void *data, int i, int thread)
+{
+    decalclip &dc = *((decalclip **)data)[i];
+    dc.gentris(worldroot, ivec(0, 0, 0), worldsize>>1);
+}
+
+// clips the decals added since the last flush in parallel, then adds them in the order they were made
+static void flushdecals()
+{
+    if(!numdecalclips) return;
+    runjobs(clipdecal, decalclips.getbuf(), numdecalclips);
+    loopi(numdecalclips) decalclips[i]->owner->commitdecal(*decalclips[i]);
+    numdecalclips = 0;
+}
+
 void initdecals()
 {
+    numdecalclips = 0;
     loopi(sizeof(decals)/sizeof(decals[0])) decals[i].init(maxdecaltris);
 }
 
 void cleardecals()
 {
+    numdecalclips = 0;
     loopi(sizeof(decals)/sizeof(decals[0])) decals[i].cleardecals();
 }
 
@@ -595,6 +647,7 @@ VARNP(decals, showdecals, 0, 1, 1);
 
 void renderdecals(bool mainpass)
 {
+    flushdecals();
     bool rendered = false;
     loopi(sizeof(decals)/sizeof(decals[0]))
     {
@@ -622,7 +675,8 @@ VARP(maxdecaldistance, 1, 512, 10000);
 void adddecal(int type, const vec &center, const vec &surface, float radius, const bvec &color, int info)
 {
     if(!showdecals || type<0 || (size_t)type>=sizeof(decals)/sizeof(decals[0]) || center.dist(camera1->o) - radius > maxdecaldistance) return;
-    decalrenderer &d = decals[type];
-    d.adddecal(center, surface, radius, color, info);
+    if(numdecalclips >= MAXDECALCLIPS) flushdecals();
+    if(numdecalclips >= decalclips.length()) decalclips.add(new decalclip);
+    decals[type].adddecal(*decalclips[numdecalclips++], center, surface, radius, color, info);
 }
  
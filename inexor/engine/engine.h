@@ -182,6 +182,7 @@ extern bool reloadtexture(Texture &tex);
 extern bool reloadtexture(const char *name);
 extern void setuptexcompress();
 extern void clearslots();
+extern void preloadslots();
 extern void compacteditvslots();
 extern void compactmruvslots();
 extern void compactvslots(cube *c, int n = 8);
@@ -491,6 +492,9 @@ extern const char *addreleaseaction(char *s);
 extern void writebinds(stream *f);
 extern void writecompletions(stream *f);
 
+// jobs
+extern void cleanupjobs();
+
 // main
 enum
 {
@@ -539,10 +543,6 @@ extern bool pointincube(const clipplanes &p, const vec &v);
 extern bool overlapsdynent(const vec &o, float radius);
 extern void rotatebb(vec &center, vec &radius, int yaw);
 extern float shadowray(const vec &o, const vec &ray, float radius, int mode, extentity *t = NULL);
-struct ShadowRayCache;
-extern ShadowRayCache *newshadowraycache();
-extern void freeshadowraycache(ShadowRayCache *&cache);
-extern void resetshadowraycache(ShadowRayCache *cache);
 extern float shadowray(ShadowRayCache *cache, const vec &o, const vec &ray, float radius, int mode, extentity *t = NULL);
 
 // world
@@ -636,6 +636,7 @@ extern void clearmapsounds();
 extern void checkmapsounds();
 extern void updatesounds();
 extern void preloadmapsounds();
+extern void flushpreloadedsounds();
 
 extern void initmumble();
 extern void closemumble();
@@ -44,6 +44,25 @@ struct grassgroup
 
 static vector<grassgroup> grassgroups;
 
+// quads made by the job threads other than the calling one, merged into grassverts/grassgroups afterwards
+struct grassbuffer
+{
+    vector<grassvert> verts;
+    vector<grassgroup> groups;
+};
+
+static grassbuffer grassbuffers[MAXJOBTHREADS];
+
+// a grass triangle that passed the checks which have to stay on the main thread
+struct grassjob
+{
+    const grasstri *tri;
+    Texture *tex;
+    float dist;
+};
+
+static vector<grassjob> grassjobs;
+
 #define NUMGRASSOFFSETS 32
 
 static float grassoffsets[NUMGRASSOFFSETS] = { -1 }, grassanimoffsets[NUMGRASSOFFSETS];
@@ -67,7 +86,7 @@ HVARFR(grasscolour, 0, 0xFFFFFF, 0xFFFFFF,
 });
 FVARR(grassalpha, 0, 1, 1);
  
-static void gengrassquads(grassgroup *&group, const grasswedge &w, const grasstri &g, Texture *tex)
+static void gengrassquads(vector<grassvert> &verts, vector<grassgroup> &groups, grassgroup *&group, const grasswedge &w, const grasstri &g, Texture *tex)
 {
     float t = camera1->o.dot(w.dir);
     int tstep = int(ceil(t/grassstep));
@@ -156,16 +175,15 @@ static void gengrassquads(grassgroup *&group, const grasswedge &w, const grasstr
 
         if(!group)
         {
-            group = &grassgroups.add();
+            group = &groups.add();
             group->tri = &g;
             group->tex = tex->id;
             extern bool brightengeom;
             extern int fullbright;
             int lmid = brightengeom && (g.lmid < LMID_RESERVED || (fullbright && editmode)) ? LMID_BRIGHT : g.lmid;
             group->lmtex = lightmaptexs.inrange(lmid) ? lightmaptexs[lmid].id : notexture->id;
-            group->offset = grassverts.length();
+            group->offset = verts.length();
             group->numquads = 0;
-            if(lastgrassanim!=lastmillis) animategrass();
         }
   
         group->numquads++;
@@ -180,7 +198,7 @@ static void gengrassquads(grassgroup *&group, const grasswedge &w, const grasstr
         bvec4 color(grasscolor, uchar(fade*grassalpha*255));
 
         #define GRASSVERT(n, tcv, modify) { \
-            grassvert &gv = grassverts.add(); \
+            grassvert &gv = verts.add(); \
             gv.pos = p##n; \
             gv.color = color; \
             gv.u = tc##n; gv.v = tcv; \
@@ -211,15 +229,27 @@ static void gengrassquads(vtxarray *va)
             s.grasstex = textureload(s.autograss, 2);
         }
 
-        grassgroup *group = NULL;
-        loopi(NUMGRASSWEDGES)
-        {
-            grasswedge &w = grasswedges[i];    
-            if(w.bound1.dist(g.center) > g.radius || w.bound2.dist(g.center) > g.radius) continue;
-            gengrassquads(group, w, g, s.grasstex);
-        }
-        if(group) group->dist = dist;
+        grassjob &j = grassjobs.add();
+        j.tri = &g;
+        j.tex = s.grasstex;
+        j.dist = dist;
+    }
+}
+
+static void gengrassjob(void *data, int i, int thread)
+{
+    const grassjob &j = ((const grassjob *)data)[i];
+    vector<grassvert> &verts = thread ? grassbuffers[thread].verts : grassverts;
+    vector<grassgroup> &groups = thread ? grassbuffers[thread].groups : grassgroups;
+    const grasstri &g = *j.tri;
+    grassgroup *group = NULL;
+    loopk(NUMGRASSWEDGES)
+    {
+        const grasswedge &w = grasswedges[k];
+        if(w.bound1.dist(g.center) > g.radius || w.bound2.dist(g.center) > g.radius) continue;
+        gengrassquads(verts, groups, group, w, g, j.tex);
     }
+    if(group) group->dist = j.dist;
 }
 
 static inline bool comparegrassgroups(const grassgroup &x, const grassgroup &y)
@@ -233,6 +263,7 @@ void generategrass()
 
     grassgroups.setsize(0);
     grassverts.setsize(0);
+    grassjobs.setsize(0);
 
     if(grassoffsets[0] < 0) loopi(NUMGRASSOFFSETS) grassoffsets[i] = rnd(0x1000000)/float(0x1000000);
 
@@ -252,6 +283,21 @@ void generategrass()
         gengrassquads(va);
     }
 
+    if(grassjobs.empty()) return;
+    if(lastgrassanim!=lastmillis) animategrass();
+
+    runjobs(gengrassjob, grassjobs.getbuf(), grassjobs.length(), 16);
+    for(int i = 1; i < MAXJOBTHREADS; i++)
+    {
+        grassbuffer &buf = grassbuffers[i];
+        if(buf.groups.empty()) continue;
+        int offset = grassverts.length();
+        loopvj(buf.groups) grassgroups.add(buf.groups[j]).offset += offset;
+        grassverts.put(buf.verts.getbuf(), buf.verts.length());
+        buf.groups.setsize(0);
+        buf.verts.setsize(0);
+    }
+
     grassgroups.sort(comparegrassgroups);
 }
 
@@ -0,0 +1,149 @@
+// jobs.cpp: a small pool of worker threads that per frame work can be spread across
+
+#include "inexor/engine/engine.h"
+
+VARP(jobthreads, 0, 2, MAXJOBTHREADS-1);
+
+struct jobworker
+{
+    SDL_Thread *thread;
+    int index, generation;
+    bool quit;
+};
+
+static vector<jobworker *> jobworkers;
+static SDL_mutex *joblock = NULL, *jobrunlock = NULL;
+static SDL_cond *jobcond = NULL, *jobdone = NULL;
+static int jobgeneration = 0, jobsbusy = 0, nextjob = 0, numjobs = 0, jobbatch = 1, workerthreads = -1;
+static jobfunc curjob = NULL;
+static void *curjobdata = NULL;
+
+static void dojobs(int thread)
+{
+    for(;;)
+    {
+        SDL_LockMutex(joblock);
+        int start = nextjob, end = min(start + jobbatch, numjobs);
+        nextjob = end;
+        SDL_UnlockMutex(joblock);
+        if(start >= end) break;
+        for(int i = start; i < end; i++) curjob(curjobdata, i, thread);
+    }
+}
+
+static int jobworkerthread(void *data)
+{
+    jobworker *w = (jobworker *)data;
+    SDL_LockMutex(joblock);
+    for(;;)
+    {
+        while(!w->quit && w->generation == jobgeneration) SDL_CondWait(jobcond, joblock);
+        if(w->quit) break;
+        w->generation = jobgeneration;
+        SDL_UnlockMutex(joblock);
+        dojobs(w->index);
+        SDL_LockMutex(joblock);
+        if(!--jobsbusy) SDL_CondSignal(jobdone);
+    }
+    SDL_UnlockMutex(joblock);
+    return 0;
+}
+
+static void cleanupjobworkers()
+{
+    if(jobworkers.length())
+    {
+        SDL_LockMutex(joblock);
+        loopv(jobworkers) jobworkers[i]->quit = true;
+        SDL_CondBroadcast(jobcond);
+        SDL_UnlockMutex(joblock);
+    }
+    while(jobworkers.length())
+    {
+        jobworker *w = jobworkers.pop();
+        SDL_WaitThread(w->thread, NULL);
+        delete w;
+    }
+}
+
+static void setupjobworkers()
+{
+    cleanupjobworkers();
+    workerthreads = jobthreads;
+    if(!joblock) joblock = SDL_CreateMutex();
+    if(!jobcond) jobcond = SDL_CreateCond();
+    if(!jobdone) jobdone = SDL_CreateCond();
+    if(!joblock || !jobcond || !jobdone) return;
+    loopi(workerthreads)
+    {
+        jobworker *w = new jobworker;
+        w->index = i+1;
+        w->generation = jobgeneration;
+        w->quit = false;
+        w->thread = SDL_CreateThread(jobworkerthread, "job worker", w);
+        if(!w->thread) { delete w; break; }
+        jobworkers.add(w);
+    }
+}
+
+// joins the workers at exit; jobs started afterwards set them up again
+void cleanupjobs()
+{
+    if(jobrunlock) SDL_LockMutex(jobrunlock);
+    cleanupjobworkers();
+    workerthreads = -1;
+    if(jobcond) { SDL_DestroyCond(jobcond); jobcond = NULL; }
+    if(jobdone) { SDL_DestroyCond(jobdone); jobdone = NULL; }
+    if(joblock) { SDL_DestroyMutex(joblock); joblock = NULL; }
+    if(jobrunlock) { SDL_UnlockMutex(jobrunlock); SDL_DestroyMutex(jobrunlock); jobrunlock = NULL; }
+}
+
+static bool initjobs()
+{
+    if(!jobrunlock) jobrunlock = SDL_CreateMutex();
+    return jobrunlock != NULL;
+}
+
+// the workers serve one caller at a time; while another thread has them, this one gets none
+int numjobthreads()
+{
+    if(!initjobs() || SDL_TryLockMutex(jobrunlock)) return 1;
+    if(jobthreads != workerthreads) setupjobworkers();
+    int n = jobworkers.length() + 1;
+    SDL_UnlockMutex(jobrunlock);
+    return n;
+}
+
+// runs job(data, i, thread) for i in [0, count) and returns once all of them are done;
+// the calling thread takes part as thread 0, so with jobthreads 0, or while the workers are busy
+// with another thread's jobs, everything runs in order on it
+void runjobs(jobfunc job, void *data, int count, int batch)
+{
+    if(count <= 0) return;
+    batch = max(batch, 1);
+    if(count > batch && initjobs() && !SDL_TryLockMutex(jobrunlock))
+    {
+        if(jobthreads != workerthreads) setupjobworkers();
+        if(jobworkers.length())
+        {
+            SDL_LockMutex(joblock);
+            curjob = job;
+            curjobdata = data;
+            numjobs = count;
+            jobbatch = batch;
+            nextjob = 0;
+            jobsbusy = jobworkers.length();
+            jobgeneration++;
+            SDL_CondBroadcast(jobcond);
+            SDL_UnlockMutex(joblock);
+            dojobs(0);
+            SDL_LockMutex(joblock);
+            while(jobsbusy) SDL_CondWait(jobdone, joblock);
+            SDL_UnlockMutex(joblock);
+            SDL_UnlockMutex(jobrunlock);
+            return;
+        }
+        SDL_UnlockMutex(jobrunlock);
+    }
+    loopi(count) job(data, i, 0);
+}
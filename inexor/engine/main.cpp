@@ -39,6 +39,8 @@ void cleanup()
 
     recorder::stop();
     cleanupserver();
+    game::cleargame();
+    cleanupjobs();
     
     /// "Use this function to set a window's input grab mode."
     /// https://wiki.libsdl.org/SDL_SetWindowGrab
@@ -59,6 +61,8 @@ void cleanup()
     clear_console();
     clear_mdls();
     clear_sound();
+    // after the sounds are gone, so reads failed back to them do not try the next file
+    cleanupasyncfiles();
     closelogfile();
     
     /// "Use this function to clean up all initialized subsystems. You should call it upon all exit conditions."
@@ -1490,6 +1494,7 @@ int main(int argc, char **argv)
         updatetime();
 
         metapp->tick();
+        checkasyncfiles();
 
         checkinput();
         menuprocess();
@@ -9,6 +9,14 @@
 #include "inexor/shared/cube.h"
 #include <signal.h>
 #include <enet/time.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <errno.h>
+#endif
 
 #define INPUT_LIMIT 4096
 #define OUTPUT_LIMIT (64*1024)
@@ -16,13 +24,19 @@
 #define AUTH_TIME (30*1000)
 #define AUTH_LIMIT 100
 #define AUTH_THROTTLE 1000
+#define AUTH_BATCH 16
+#ifdef __linux__
+#define CLIENT_LIMIT 65536
+#else
 #define CLIENT_LIMIT 4096
+#endif
 #define DUP_LIMIT 16
 #define PING_TIME 3000
 #define PING_RETRY 5
 #define KEEPALIVE_TIME (65*60*1000)
 #define SERVER_LIMIT 4096
 #define SERVER_DUP_LIMIT 10
+#define SERVERLIST_HISTORY 16
 
 FILE *logfile = NULL;
 
@@ -42,24 +56,27 @@ void adduser(char *name, char *pubkey)
 }
 COMMAND(adduser, "ss");
 
+void waitauthjobs();
+
 void clearusers()
 {
+    waitauthjobs();
     enumerate(users, userinfo, u, { delete[] u.name; freepubkey(u.pubkey); });
     users.clear();
 }
 COMMAND(clearusers, "");
 
-vector<ipmask> bans, servbans, gbans;
+ipmasktable bans, servbans, gbans;
 
 void clearbans()
 {
-    bans.shrink(0);
-    servbans.shrink(0);
-    gbans.shrink(0);
+    bans.clear();
+    servbans.clear();
+    gbans.clear();
 }
 COMMAND(clearbans, "");
 
-void addban(vector<ipmask> &bans, const char *name)
+void addban(ipmasktable &bans, const char *name)
 {
     ipmask ban;
     ban.parse(name);
@@ -69,10 +86,19 @@ ICOMMAND(ban, "s", (char *name), addban(bans, name));
 ICOMMAND(servban, "s", (char *name), addban(servbans, name));
 ICOMMAND(gban, "s", (char *name), addban(gbans, name));
 
-bool checkban(vector<ipmask> &bans, enet_uint32 host)
+void loadbans(ipmasktable &bans, const char *filename)
+{
+    int n = bans.load(filename);
+    if(n < 0) conoutf("could not read ban list %s", filename);
+    else conoutf("loaded %d bans from %s", n, filename);
+}
+ICOMMAND(banfile, "s", (char *name), loadbans(bans, name));
+ICOMMAND(servbanfile, "s", (char *name), loadbans(servbans, name));
+ICOMMAND(gbanfile, "s", (char *name), loadbans(gbans, name));
+
+bool checkban(ipmasktable &bans, enet_uint32 host)
 {
-    loopv(bans) if(bans[i].check(host)) return true;
-    return false;
+    return bans.check(host);
 }
 
 struct authreq
@@ -91,6 +117,27 @@ struct gameserver
 };
 vector<gameserver *> gameservers;
 
+struct client;
+
+/// connections and registered servers sharing an ip, so per-ip limits and lookups never scan everything
+struct iphost
+{
+    vector<client *> clients; ///< in connection order
+    vector<gameserver *> servers;
+};
+hashtable<int, iphost> iphosts;
+
+iphost *findiphost(enet_uint32 host)
+{
+    return iphosts.access(int(host));
+}
+
+void releaseiphost(enet_uint32 host)
+{
+    iphost *h = findiphost(host);
+    if(h && h->clients.empty() && h->servers.empty()) iphosts.remove(int(host));
+}
+
 struct messagebuf
 {
     vector<messagebuf *> &owner;
@@ -119,9 +166,35 @@ struct messagebuf
         buf.put(m.buf.getbuf(), m.buf.length());
     }
 };
-vector<messagebuf *> gameserverlists, gbanlists;
+vector<messagebuf *> gameserverlists, gbanlists, serverlistupdates;
 bool updateserverlist = true;
 
+struct serverlistentry
+{
+    enet_uint32 host;
+    int port;
+};
+
+static inline bool serverlistentrycmp(const serverlistentry &x, const serverlistentry &y)
+{
+    return x.host < y.host || (x.host == y.host && x.port < y.port);
+}
+
+/// the set of listed servers as of one server list version; clients that send the version
+/// they last received only get the changes since then
+struct serverlistsnapshot
+{
+    int version;
+    vector<serverlistentry> servers;
+    messagebuf *update; ///< changes from this version to the current one, built on demand
+
+    serverlistsnapshot(int version) : version(version), update(NULL) {}
+    ~serverlistsnapshot() { if(update) update->purge(); }
+};
+vector<serverlistsnapshot *> serverlisthistory;
+messagebuf *fullserverlist = NULL; ///< versioned full list, for clients with an unknown version
+int serverlistversion = 0;
+
 struct client
 {
     ENetAddress address;
@@ -136,10 +209,15 @@ struct client
     vector<authreq> authreqs;
     bool shouldpurge;
     bool registeredserver;
+    int index;
+    bool queuedwrite;
+
+    int listversion;
+    int authjobs; ///< challenges still being generated, the client is not freed before they are done
 
-    client() : message(NULL), inputpos(0), outputpos(0), servport(-1), lastauth(0), shouldpurge(false), registeredserver(false) {}
+    client() : message(NULL), inputpos(0), outputpos(0), servport(-1), lastauth(0), shouldpurge(false), registeredserver(false), index(-1), queuedwrite(false), listversion(-1), authjobs(0) {}
 };
-vector<client *> clients;
+vector<client *> clients, purgedclients, writeclients;
 
 ENetSocket serversocket = ENET_SOCKET_NULL;
 
@@ -178,19 +256,53 @@ void conoutf(int type, const char *fmt, ...)
     va_end(args);
 }
 
-void purgeclient(int n)
+/// drops a connection; the client itself is only freed by deletepurgedclients(), since pending
+/// socket events may still refer to it
+void purgeclient(client &c)
 {
-    client &c = *clients[n];
     if(c.message) c.message->purge();
+    c.message = NULL;
     enet_socket_destroy(c.socket);
-    delete clients[n];
-    clients.remove(n);
+    c.socket = ENET_SOCKET_NULL;
+    iphost *h = findiphost(c.address.host);
+    if(h)
+    {
+        h->clients.removeobj(&c);
+        releaseiphost(c.address.host);
+    }
+    clients.removeunordered(c.index);
+    if(clients.inrange(c.index)) clients[c.index]->index = c.index;
+    c.index = -1;
+    purgedclients.add(&c);
+}
+
+void deletepurgedclients()
+{
+    loopvrev(purgedclients) if(!purgedclients[i]->authjobs) delete purgedclients.removeunordered(i);
+}
+
+/// remembers that c has new output, which is sent once the current events are handled
+void queuewrite(client &c)
+{
+#ifdef __linux__
+    if(c.queuedwrite || c.socket == ENET_SOCKET_NULL) return;
+    c.queuedwrite = true;
+    writeclients.add(&c);
+#endif
+}
+
+void setmessage(client &c, messagebuf *m)
+{
+    c.message = m;
+    c.message->refs++;
+    queuewrite(c);
 }
 
 void output(client &c, const char *msg, int len = 0)
 {
     if(!len) len = strlen(msg);
     c.output.put(msg, len);
+    queuewrite(c);
 }
 
 void outputf(client &c, const char *fmt, ...)
@@ -241,27 +353,114 @@ void setupserver(int port, const char *ip = NULL)
     enet_time_set(0);
 
     starttime = time(NULL);
+    // versions of a restarted master must not match the ones its clients remember
+    serverlistversion = int(starttime & 0x3FFFFFFF);
     char *ct = ctime(&starttime);
     if(strchr(ct, '\n')) *strchr(ct, '\n') = '\0';
     conoutf("*** Starting master server on %s %d at %s ***", ip ? ip : "localhost", port, ct);
 }
 
+void addserverline(messagebuf *l, const char *cmd, enet_uint32 host, int port)
+{
+    ENetAddress address;
+    address.host = host;
+    address.port = port;
+    string ip;
+    if(enet_address_get_host_ip(&address, ip, sizeof(ip)) < 0) return;
+    defformatstring(line)("%s %s %d\n", cmd, ip, port);
+    l->buf.put(line, strlen(line));
+}
+
+void endserverlist(messagebuf *l)
+{
+    defformatstring(line)("serverlistversion %d\n", serverlistversion);
+    l->buf.put(line, strlen(line));
+    l->buf.add('\0');
+}
+
 void genserverlist()
 {
     if(!updateserverlist) return;
     while(gameserverlists.length() && gameserverlists.last()->refs<=0)
         delete gameserverlists.pop();
     messagebuf *l = new messagebuf(gameserverlists);
+    serverlistsnapshot *snapshot = new serverlistsnapshot(++serverlistversion);
     loopv(gameservers)
     {
         gameserver &s = *gameservers[i];
         if(!s.lastpong) continue;
         defformatstring(cmd)("addserver %s %d\n", s.ip, s.port);
         l->buf.put(cmd, strlen(cmd));
+        serverlistentry &e = snapshot->servers.add();
+        e.host = s.address.host;
+        e.port = s.port;
     }
     l->buf.add('\0');
     gameserverlists.add(l);
     updateserverlist = false;
+
+    // all cached updates lead to the previous version now
+    loopv(serverlisthistory) if(serverlisthistory[i]->update)
+    {
+        serverlisthistory[i]->update->purge();
+        serverlisthistory[i]->update = NULL;
+    }
+    if(fullserverlist) { fullserverlist->purge(); fullserverlist = NULL; }
+    loopvrev(serverlistupdates) if(serverlistupdates[i]->refs<=0) delete serverlistupdates.remove(i);
+
+    snapshot->servers.sort(serverlistentrycmp);
+    if(serverlisthistory.length() >= SERVERLIST_HISTORY) delete serverlisthistory.remove(0);
+    serverlisthistory.add(snapshot);
+}
+
+/// the server list for a client that last received version, shared by all clients asking for the same
+messagebuf *getserverlist(int version)
+{
+    genserverlist();
+    if(serverlisthistory.empty()) return NULL;
+    serverlistsnapshot *old = NULL, *cur = serverlisthistory.last();
+    loopv(serverlisthistory) if(serverlisthistory[i]->version == version) { old = serverlisthistory[i]; break; }
+    if(!old)
+    {
+        if(!fullserverlist)
+        {
+            fullserverlist = new messagebuf(serverlistupdates);
+            const char *header = "clearservers\n";
+            fullserverlist->buf.put(header, strlen(header));
+            loopv(cur->servers) addserverline(fullserverlist, "addserver", cur->servers[i].host, cur->servers[i].port);
+            endserverlist(fullserverlist);
+            fullserverlist->refs++;
+            serverlistupdates.add(fullserverlist);
+        }
+        return fullserverlist;
+    }
+    if(!old->update)
+    {
+        messagebuf *l = new messagebuf(serverlistupdates);
+        defformatstring(header)("serverlistdelta %d\n", old->version);
+        l->buf.put(header, strlen(header));
+        // both lists are sorted, so one merge pass finds what was removed and added
+        int i = 0, j = 0;
+        while(i < old->servers.length() || j < cur->servers.length())
+        {
+            if(j >= cur->servers.length() || (i < old->servers.length() && serverlistentrycmp(old->servers[i], cur->servers[j])))
+            {
+                addserverline(l, "delserver", old->servers[i].host, old->servers[i].port);
+                i++;
+            }
+            else if(i >= old->servers.length() || serverlistentrycmp(cur->servers[j], old->servers[i]))
+            {
+                addserverline(l, "addserver", cur->servers[j].host, cur->servers[j].port);
+                j++;
+            }
+            else { i++; j++; }
+        }
+        endserverlist(l);
+        l->refs++;
+        serverlistupdates.add(l);
+        old->update = l;
+    }
+    return old->update;
 }
 
 void gengbanlist()
@@ -273,7 +472,7 @@ void gengbanlist()
     int cmdlen = strlen(cmd);
     loopv(gbans)
     {
-        ipmask &b = gbans[i];
+        const ipmask &b = gbans[i];
         l->buf.put(cmd, cmdlen + b.print(&cmd[cmdlen])); 
         l->buf.add('\n');
     }
@@ -293,23 +492,18 @@ void gengbanlist()
     loopv(clients)
     {
         client &c = *clients[i];
-        if(c.servport >= 0 && !c.message) 
-        {
-            c.message = l;
-            c.message->refs++;
-        }
+        if(c.servport >= 0 && !c.message) setmessage(c, l);
     }
 }
 
 void addgameserver(client &c)
 {
     if(gameservers.length() >= SERVER_LIMIT) return;
-    int dups = 0;
-    loopv(gameservers)
+    iphost &h = iphosts[int(c.address.host)];
+    int dups = h.servers.length();
+    loopv(h.servers)
     {
-        gameserver &s = *gameservers[i];
-        if(s.address.host != c.address.host) continue;
-        ++dups;
+        gameserver &s = *h.servers[i];
         if(s.port == c.servport)
         {
             s.lastping = 0;
@@ -329,6 +523,7 @@ void addgameserver(client &c)
         return;
     }
     gameserver &s = *gameservers.add(new gameserver);
+    h.servers.add(&s);
     s.address.host = c.address.host;
     s.address.port = c.servport+1;
     copystring(s.ip, hostname);
@@ -337,13 +532,25 @@ void addgameserver(client &c)
     s.lastping = s.lastpong = 0;
 }
 
+void removegameserver(int n)
+{
+    gameserver *s = gameservers.remove(n);
+    iphost *h = findiphost(s->address.host);
+    if(h)
+    {
+        h->servers.removeobj(s);
+        releaseiphost(s->address.host);
+    }
+    delete s;
+}
+
 client *findclient(gameserver &s)
 {
-    loopv(clients)
+    iphost *h = findiphost(s.address.host);
+    if(h) loopv(h->clients)
     {
-        client &c = *clients[i];
-        if(s.address.host == c.address.host && s.port == c.servport)
-            return &c;
+        client &c = *h->clients[i];
+        if(s.port == c.servport) return &c;
     }
     return NULL;
 }
@@ -365,10 +572,11 @@ void checkserverpongs()
         buf.dataLength = sizeof(pong);
         int len = enet_socket_receive(pingsocket, &addr, &buf, 1);
         if(len <= 0) break;
-        loopv(gameservers)
+        iphost *h = findiphost(addr.host);
+        if(h) loopv(h->servers)
         {
-            gameserver &s = *gameservers[i];
-            if(s.address.host == addr.host && s.address.port == addr.port)
+            gameserver &s = *h->servers[i];
+            if(s.address.port == addr.port)
             {
                 if(s.lastping && (!s.lastpong || ENET_TIME_GREATER(s.lastping, s.lastpong)))
                 {
@@ -377,11 +585,7 @@ void checkserverpongs()
                     {
                         c->registeredserver = true;
                         outputf(*c, "succreg\n");
-                        if(!c->message && gbanlists.length())
-                        {
-                            c->message = gbanlists.last();
-                            c->message->refs++;
-                        }
+                        if(!c->message && gbanlists.length()) setmessage(*c, gbanlists.last());
                     }
                 }
                 if(!s.lastpong) updateserverlist = true;
@@ -396,7 +600,7 @@ void bangameservers()
 {
     loopvrev(gameservers) if(checkban(servbans, gameservers[i]->address.host))
     {
-        delete gameservers.remove(i);
+        removegameserver(i);
         updateserverlist = true;
     }
 }
@@ -411,7 +615,7 @@ void checkgameservers()
         {
             if(ENET_TIME_DIFFERENCE(servtime, s.lastpong) > KEEPALIVE_TIME)
             {
-                delete gameservers.remove(i--);
+                removegameserver(i--);
                 updateserverlist = true;
             }
         }
@@ -420,7 +624,7 @@ void checkgameservers()
             if(s.numpings >= PING_RETRY)
             {
                 servermessage(s, "failreg failed pinging server\n");
-                delete gameservers.remove(i--);
+                removegameserver(i--);
                 updateserverlist = true;
             }
             else
@@ -446,6 +650,147 @@ void messagebuf::purge()
     }
 }
 
+/// challenges are generated on worker threads, so a burst of auth requests (e.g. every server
+/// re-authing its players after a master restart) does not stall the connection loop
+struct authjob
+{
+    client *c;
+    uint id;
+    void *pubkey;
+    uint seed[3];
+    vector<char> challenge;
+    void *answer;
+};
+vector<authjob *> authqueue, authresults; ///< guarded by authmutex
+int authbusy = 0; ///< jobs queued or being worked on, guarded by authmutex
+int authpending = 0; ///< jobs whose results were not collected yet, main thread only
+int authworkers = 0;
+vector<std::thread *> authworkerthreads;
+bool authexit = false; ///< tells the workers to stop, guarded by authmutex
+std::mutex authmutex;
+std::condition_variable authcond, authdonecond;
+
+VAR(auththreads, 0, 2, 16);
+
+/// takes jobs off the queue in batches, so a storm costs one lock round trip per batch rather than per request
+void authworker()
+{
+    vector<authjob *> batch;
+    for(;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(authmutex);
+            while(authqueue.empty() && !authexit) authcond.wait(lock);
+            if(authexit) break;
+            int n = clamp((authqueue.length() + authworkers - 1) / authworkers, 1, AUTH_BATCH);
+            batch.put(authqueue.getbuf(), n);
+            authqueue.remove(0, n);
+        }
+        loopv(batch)
+        {
+            authjob &j = *batch[i];
+            j.answer = genchallenge(j.pubkey, j.seed, sizeof(j.seed), j.challenge);
+        }
+        {
+            std::lock_guard<std::mutex> lock(authmutex);
+            authresults.put(batch.getbuf(), batch.length());
+            authbusy -= batch.length();
+        }
+        authdonecond.notify_all();
+        batch.setsize(0);
+    }
+}
+
+/// starts the workers on first use; returns false if challenges have to be generated inline
+bool startauthworkers()
+{
+    if(authworkers) return true;
+    if(auththreads <= 0) return false;
+    initchallenges();
+    std::lock_guard<std::mutex> lock(authmutex);
+    loopi(auththreads)
+    {
+        try { authworkerthreads.add(new std::thread(authworker)); }
+        catch(const std::system_error &) { break; }
+        authworkers++;
+    }
+    if(!authworkers) conoutf("failed to start auth threads, generating challenges inline");
+    return authworkers > 0;
+}
+
+/// joins the workers at exit, before the statics they wait on are destroyed; queued jobs are dropped
+void stopauthworkers()
+{
+    if(!authworkers) return;
+    {
+        std::lock_guard<std::mutex> lock(authmutex);
+        authexit = true;
+    }
+    authcond.notify_all();
+    loopv(authworkerthreads)
+    {
+        authworkerthreads[i]->join();
+        delete authworkerthreads[i];
+    }
+    authworkerthreads.setsize(0);
+    authworkers = 0;
+}
+
+void queueauth(client &c, uint id, void *pubkey, const uint seed[3])
+{
+    authjob *j = new authjob;
+    j->c = &c;
+    j->id = id;
+    j->pubkey = pubkey;
+    memcpy(j->seed, seed, sizeof(j->seed));
+    j->answer = NULL;
+    c.authjobs++;
+    authpending++;
+    {
+        std::lock_guard<std::mutex> lock(authmutex);
+        authqueue.add(j);
+        authbusy++;
+    }
+    authcond.notify_one();
+}
+
+/// answers the requests whose challenges are done, unless they expired or the client left meanwhile
+void checkauthjobs()
+{
+    if(!authpending) return;
+    static vector<authjob *> done;
+    {
+        std::lock_guard<std::mutex> lock(authmutex);
+        if(authresults.empty()) return;
+        done.put(authresults.getbuf(), authresults.length());
+        authresults.setsize(0);
+    }
+    loopv(done)
+    {
+        authjob *j = done[i];
+        client &c = *j->c;
+        c.authjobs--;
+        authpending--;
+        authreq *a = NULL;
+        if(c.socket != ENET_SOCKET_NULL) loopvk(c.authreqs) if(c.authreqs[k].id == j->id && !c.authreqs[k].answer) { a = &c.authreqs[k]; break; }
+        if(a)
+        {
+            a->answer = j->answer;
+            outputf(c, "chalauth %u %s\n", j->id, j->challenge.getbuf());
+        }
+        else freechallenge(j->answer);
+        delete j;
+    }
+    done.setsize(0);
+}
+
+/// blocks until the workers no longer use any public key
+void waitauthjobs()
+{
+    std::unique_lock<std::mutex> lock(authmutex);
+    while(authbusy > 0) authdonecond.wait(lock);
+}
+
 void purgeauths(client &c)
 {
     int expired = 0;
@@ -499,7 +844,13 @@ void reqauth(client &c, uint id, char *name)
     authreq &a = c.authreqs.add();
     a.reqtime = servtime;
     a.id = id;
+    a.answer = NULL;
     uint seed[3] = { uint(starttime), servtime, randomMT() };
+    if(startauthworkers())
+    {
+        queueauth(c, id, u->pubkey, seed);
+        return;
+    }
     static vector<char> buf;
     buf.setsize(0);
     a.answer = genchallenge(u->pubkey, seed, sizeof(seed), buf);
@@ -515,7 +866,7 @@ void confauth(client &c, uint id, const char *val)
     {
         string ip;
         if(enet_address_get_host_ip(&c.address, ip, sizeof(ip)) < 0) copystring(ip, "-");
-        if(checkchallenge(val, c.authreqs[i].answer))
+        if(c.authreqs[i].answer && checkchallenge(val, c.authreqs[i].answer))
         {
             outputf(c, "succauth %u\n", id);
             conoutf("succeeded %u from %s", id, ip);
@@ -546,15 +897,21 @@ bool checkclientinput(client &c)
         string user, val;
         if(!strncmp(c.input, "list", 4) && (!c.input[4] || c.input[4] == '\n' || c.input[4] == '\r'))
         {
-            genserverlist();
-            if(gameserverlists.empty() || c.message) return false;
-            c.message = gameserverlists.last();
-            c.message->refs++;
+            messagebuf *l = NULL;
+            if(c.listversion >= 0) l = getserverlist(c.listversion);
+            else
+            {
+                genserverlist();
+                if(gameserverlists.length()) l = gameserverlists.last();
+            }
+            if(!l || c.message) return false;
+            setmessage(c, l);
             c.output.setsize(0);
             c.outputpos = 0;
             c.shouldpurge = true;
             return true;
         }
+        else if(sscanf(c.input, "listversion %d", &c.listversion) == 1) {}
         else if(sscanf(c.input, "regserv %d", &port) == 1)
         {
             if(checkban(servbans, c.address.host)) return false;
@@ -581,10 +938,184 @@ bool checkclientinput(client &c)
     return c.inputpos<(int)sizeof(c.input);
 }
 
-ENetSocketSet readset, writeset;
+void addclient(ENetSocket clientsocket, ENetAddress &address);
+
+/// accepts all pending connections
+void acceptclients()
+{
+    for(;;)
+    {
+        ENetAddress address;
+        ENetSocket clientsocket = enet_socket_accept(serversocket, &address);
+        if(clientsocket==ENET_SOCKET_NULL) break;
+        if(clients.length()>=CLIENT_LIMIT || checkban(bans, address.host)) enet_socket_destroy(clientsocket);
+        else addclient(clientsocket, address);
+    }
+}
+
+client *newclient(ENetSocket clientsocket, ENetAddress &address)
+{
+    iphost &h = iphosts[int(address.host)];
+    if(h.clients.length() >= DUP_LIMIT) purgeclient(*h.clients[0]);
+
+    client *c = new client;
+    c->address = address;
+    c->socket = clientsocket;
+    c->connecttime = servtime;
+    c->lastinput = servtime;
+    c->index = clients.length();
+    clients.add(c);
+    h.clients.add(c);
+    return c;
+}
+
+/// advances the output position of c by len sent bytes;
+/// returns false once a finished server list request should drop the connection
+bool sentclientoutput(client &c, int len)
+{
+    c.outputpos += len;
+    int total = c.output.length() ? c.output.length() : c.message->length();
+    if(c.outputpos < total) return true;
+    if(c.output.length()) c.output.setsize(0);
+    else
+    {
+        c.message->purge();
+        c.message = NULL;
+    }
+    c.outputpos = 0;
+    return c.message || c.output.length() || !c.shouldpurge;
+}
+
+/// purges expired auth requests and idle connections
+void checkclienttimeouts()
+{
+    loopv(clients)
+    {
+        client &c = *clients[i];
+        if(c.authreqs.length()) purgeauths(c);
+        if(c.output.length() > OUTPUT_LIMIT) { purgeclient(c); i--; continue; }
+        if(ENET_TIME_DIFFERENCE(servtime, c.lastinput) >= (c.registeredserver ? KEEPALIVE_TIME : CLIENT_TIME)) { purgeclient(c); i--; continue; }
+    }
+}
+
+#ifdef __linux__
+/// edge triggered epoll loop: every connection is drained until the kernel would block,
+/// so handling an event costs the same no matter how many clients are connected
+int epollfd = -1;
+enet_uint32 lastclientcheck = 0;
+
+void setupepoll()
+{
+    epollfd = epoll_create1(EPOLL_CLOEXEC);
+    if(epollfd < 0) fatal("failed to create epoll instance");
+    epoll_event ev;
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.ptr = &serversocket;
+    if(epoll_ctl(epollfd, EPOLL_CTL_ADD, serversocket, &ev) < 0) fatal("failed to watch server socket");
+    ev.events = EPOLLIN;
+    ev.data.ptr = &pingsocket;
+    if(epoll_ctl(epollfd, EPOLL_CTL_ADD, pingsocket, &ev) < 0) fatal("failed to watch ping socket");
+}
+
+void addclient(ENetSocket clientsocket, ENetAddress &address)
+{
+    if(enet_socket_set_option(clientsocket, ENET_SOCKOPT_NONBLOCK, 1) < 0) { enet_socket_destroy(clientsocket); return; }
+    client *c = newclient(clientsocket, address);
+    epoll_event ev;
+    ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    ev.data.ptr = c;
+    if(epoll_ctl(epollfd, EPOLL_CTL_ADD, clientsocket, &ev) < 0) purgeclient(*c);
+}
+
+/// sends as much pending output as the socket takes; returns false if the connection is done
+bool sendclient(client &c)
+{
+    while(c.message || c.output.length())
+    {
+        const char *data = c.output.length() ? c.output.getbuf() : c.message->getbuf();
+        int len = c.output.length() ? c.output.length() : c.message->length();
+        ssize_t res = send(c.socket, &data[c.outputpos], len-c.outputpos, MSG_NOSIGNAL);
+        if(res < 0)
+        {
+            if(errno == EINTR) continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        if(!sentclientoutput(c, res)) return false;
+    }
+    return true;
+}
+
+/// reads once from the socket; returns 1 if input was handled, 0 if the socket would block and -1 if the connection is done
+int recvclient(client &c)
+{
+    ssize_t res = recv(c.socket, &c.input[c.inputpos], sizeof(c.input) - c.inputpos, 0);
+    if(res < 0) return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR ? 0 : -1;
+    if(!res) return -1;
+    c.inputpos += res;
+    c.input[min(c.inputpos, (int)sizeof(c.input)-1)] = '\0';
+    return checkclientinput(c) ? 1 : -1;
+}
+
+/// like the select loop, input is only read while no output is pending
+bool serviceclient(client &c)
+{
+    for(;;)
+    {
+        if(!sendclient(c)) return false;
+        if(c.message || c.output.length()) return true;
+        int res = recvclient(c);
+        if(res <= 0) return !res;
+    }
+}
 
 void checkclients()
 {
+    static epoll_event events[256];
+    int numevents = epoll_wait(epollfd, events, sizeof(events)/sizeof(events[0]), authpending ? 5 : 1000);
+    loopi(numevents)
+    {
+        epoll_event &ev = events[i];
+        if(ev.data.ptr == &serversocket) acceptclients();
+        else if(ev.data.ptr == &pingsocket) checkserverpongs();
+        else
+        {
+            client &c = *(client *)ev.data.ptr;
+            if(c.socket == ENET_SOCKET_NULL) continue;
+            if(ev.events & EPOLLERR || !serviceclient(c)) purgeclient(c);
+        }
+    }
+
+    if(ENET_TIME_DIFFERENCE(servtime, lastclientcheck) >= 1000 || !numevents)
+    {
+        // retry connections that could not be accepted (e.g. out of file descriptors) since the last edge
+        acceptclients();
+        checkclienttimeouts();
+        lastclientcheck = servtime;
+    }
+
+    checkauthjobs();
+
+    loopv(writeclients)
+    {
+        client &c = *writeclients[i];
+        c.queuedwrite = false;
+        if(c.socket != ENET_SOCKET_NULL && !serviceclient(c)) purgeclient(c);
+    }
+    writeclients.setsize(0);
+
+    deletepurgedclients();
+}
+#else
+void addclient(ENetSocket clientsocket, ENetAddress &address)
+{
+    newclient(clientsocket, address);
+}
+
+void checkclients()
+{
+    deletepurgedclients();
+    checkauthjobs();
+
     ENetSocketSet readset, writeset;
     ENetSocket maxsock = max(serversocket, pingsocket);
     ENET_SOCKETSET_EMPTY(readset);
@@ -599,32 +1130,10 @@ void checkclients()
         else ENET_SOCKETSET_ADD(readset, c.socket);
         maxsock = max(maxsock, c.socket);
     }
-    if(enet_socketset_select(maxsock, &readset, &writeset, 1000)<=0) return;
+    if(enet_socketset_select(maxsock, &readset, &writeset, authpending ? 5 : 1000)<=0) return;
 
     if(ENET_SOCKETSET_CHECK(readset, pingsocket)) checkserverpongs();
-    if(ENET_SOCKETSET_CHECK(readset, serversocket))
-    {
-        ENetAddress address;
-        ENetSocket clientsocket = enet_socket_accept(serversocket, &address);
-        if(clients.length()>=CLIENT_LIMIT || checkban(bans, address.host)) enet_socket_destroy(clientsocket);
-        else if(clientsocket!=ENET_SOCKET_NULL)
-        {
-            int dups = 0, oldest = -1;
-            loopv(clients) if(clients[i]->address.host == address.host)
-            {
-                dups++;
-                if(oldest<0 || clients[i]->connecttime < clients[oldest]->connecttime) oldest = i;
-            }
-            if(dups >= DUP_LIMIT) purgeclient(oldest);
-
-            client *c = new client;
-            c->address = address;
-            c->socket = clientsocket;
-            c->connecttime = servtime;
-            c->lastinput = servtime;
-            clients.add(c);
-        }
-    }
+    if(ENET_SOCKETSET_CHECK(readset, serversocket)) acceptclients();
 
     loopv(clients)
     {
@@ -637,26 +1146,7 @@ void checkclients()
             buf.data = (void *)&data[c.outputpos];
             buf.dataLength = len-c.outputpos;
             int res = enet_socket_send(c.socket, NULL, &buf, 1);
-            if(res>=0)
-            {
-                c.outputpos += res;
-                if(c.outputpos>=len)
-                {
-                    if(c.output.length()) c.output.setsize(0);
-                    else
-                    { 
-                        c.message->purge();
-                        c.message = NULL; 
-                    }
-                    c.outputpos = 0;
-                    if(!c.message && c.output.empty() && c.shouldpurge)
-                    {
-                        purgeclient(i--);
-                        continue;
-                    }
-                }
-            }
-            else { purgeclient(i--); continue; }
+            if(res<0 || !sentclientoutput(c, res)) { purgeclient(c); i--; continue; }
         }
         if(ENET_SOCKETSET_CHECK(readset, c.socket))
         {
@@ -668,18 +1158,18 @@ void checkclients()
             {
                 c.inputpos += res;
                 c.input[min(c.inputpos, (int)sizeof(c.input)-1)] = '\0';
-                if(!checkclientinput(c)) { purgeclient(i--); continue; }
+                if(!checkclientinput(c)) { purgeclient(c); i--; continue; }
             }
-            else { purgeclient(i--); continue; }
+            else { purgeclient(c); i--; continue; }
         }
-        if(c.output.length() > OUTPUT_LIMIT) { purgeclient(i--); continue; }
-        if(ENET_TIME_DIFFERENCE(servtime, c.lastinput) >= (c.registeredserver ? KEEPALIVE_TIME : CLIENT_TIME)) { purgeclient(i--); continue; }
     }
+    checkclienttimeouts();
 }
+#endif
 
 void banclients()
 {
-    loopvrev(clients) if(checkban(bans, clients[i]->address.host)) purgeclient(i);
+    loopvrev(clients) if(checkban(bans, clients[i]->address.host)) purgeclient(*clients[i]);
 }
 
 volatile int reloadcfg = 1;
@@ -695,6 +1185,7 @@ int main(int argc, char **argv)
 {
     if(enet_initialize()<0) fatal("Unable to initialise network module");
     atexit(enet_deinitialize);
+    atexit(stopauthworkers);
 
     const char *dir = "", *ip = NULL;
     int port = 28787;
@@ -712,6 +1203,9 @@ int main(int argc, char **argv)
     signal(SIGUSR1, reloadsignal);
 #endif
     setupserver(port, ip);
+#ifdef __linux__
+    setupepoll();
+#endif
     for(;;)
     {
         if(reloadcfg)
@@ -9,6 +9,9 @@
 
 #include "inexor/engine/engine.h"
 #include "SDL_mixer.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 VAR(dbgmovie, 0, 0, 1);
 
@@ -431,23 +434,65 @@ struct aviwriter
         rdst = (rt*area)>>24;
     }
  
-    void scaleyuv(const uchar *pixels, uint srcw, uint srch)
+#ifdef __SSE2__
+    static inline __m128i encodeysse(__m128i lo, __m128i hi)
+    {
+        const __m128i coeffs = _mm_setr_epi16(401, 2065, 1052, 0, 401, 2065, 1052, 0);
+        __m128 l = _mm_castsi128_ps(_mm_madd_epi16(lo, coeffs)), h = _mm_castsi128_ps(_mm_madd_epi16(hi, coeffs));
+        __m128i y = _mm_add_epi32(_mm_castps_si128(_mm_shuffle_ps(l, h, _MM_SHUFFLE(2, 0, 2, 0))), _mm_castps_si128(_mm_shuffle_ps(l, h, _MM_SHUFFLE(3, 1, 3, 1))));
+        return _mm_srli_epi32(_mm_add_epi32(y, _mm_set1_epi32(16<<12)), 12);
+    }
+
+    // same fixed point math as the scalar loop in encodeyuv, for 4 pixels of 2 rows at once
+    static inline void encodeyuvsse(const uchar *src, const uchar *src2, uchar *ydst, uchar *ydst2, uchar *udst, uchar *vdst)
+    {
+        const __m128i zero = _mm_setzero_si128(),
+                      ucoeffs = _mm_setr_epi16(450, -298, -152, 0, 450, -298, -152, 0),
+                      vcoeffs = _mm_setr_epi16(-73, -377, 450, 0, -73, -377, 450, 0);
+        __m128i p1 = _mm_loadu_si128((const __m128i *)src), p2 = _mm_loadu_si128((const __m128i *)src2),
+                lo1 = _mm_unpacklo_epi8(p1, zero), hi1 = _mm_unpackhi_epi8(p1, zero),
+                lo2 = _mm_unpacklo_epi8(p2, zero), hi2 = _mm_unpackhi_epi8(p2, zero);
+        __m128i y = _mm_packs_epi32(encodeysse(lo1, hi1), encodeysse(lo2, hi2));
+
+        __m128i s = _mm_add_epi16(lo1, lo2), t = _mm_add_epi16(hi1, hi2);
+        s = _mm_add_epi16(s, _mm_srli_si128(s, 8));
+        t = _mm_add_epi16(t, _mm_srli_si128(t, 8));
+        __m128i blocks = _mm_unpacklo_epi64(s, t);
+        __m128 u = _mm_castsi128_ps(_mm_madd_epi16(blocks, ucoeffs)), v = _mm_castsi128_ps(_mm_madd_epi16(blocks, vcoeffs));
+        __m128i uv = _mm_add_epi32(_mm_castps_si128(_mm_shuffle_ps(u, v, _MM_SHUFFLE(2, 0, 2, 0))), _mm_castps_si128(_mm_shuffle_ps(u, v, _MM_SHUFFLE(3, 1, 3, 1))));
+        uv = _mm_srai_epi32(_mm_add_epi32(uv, _mm_set1_epi32(128<<12)), 12);
+
+        uchar out[16];
+        _mm_storeu_si128((__m128i *)out, _mm_packus_epi16(y, _mm_packs_epi32(uv, uv)));
+        memcpy(ydst, out, 4);
+        memcpy(ydst2, &out[4], 4);
+        udst[0] = out[8];
+        udst[1] = out[9];
+        vdst[0] = out[10];
+        vdst[1] = out[11];
+    }
+#endif
+
+    // the converters below each fill the row pairs [start, end) of the yuv planes
+    void scaleyuv(const uchar *pixels, uint srcw, uint srch, uint start, uint end)
     {
         const int flip = -1;
         const uint planesize = videow * videoh;
-        if(!yuv) yuv = new uchar[(planesize*3)/2];
         uchar *yplane = yuv, *uplane = yuv + planesize, *vplane = yuv + planesize + planesize/4;
         const int ystride = flip*int(videow), uvstride = flip*int(videow)/2;
         if(flip < 0) { yplane -= int(videoh-1)*ystride; uplane -= int(videoh/2-1)*uvstride; vplane -= int(videoh/2-1)*uvstride; }
+        yplane += int(2*start)*ystride;
+        uplane += int(start)*uvstride;
+        vplane += int(start)*uvstride;
 
         const uint stride = srcw<<2;
         srcw &= ~1;
         srch &= ~1;
         const uint wfrac = (srcw<<12)/videow, hfrac = (srch<<12)/videoh, 
                    area = ((ullong)planesize<<12)/(srcw*srch + 1),
-                   dw = videow*wfrac, dh = videoh*hfrac;
+                   dw = videow*wfrac;
   
-        for(uint y = 0; y < dh;)
+        for(uint y = 2*start*hfrac, yend = 2*end*hfrac; y < yend;)
         {
             uint yn = y + hfrac - 1, yi = y>>12, h = (yn>>12) - yi, ylow = ((yn|(-int(h)>>24))&0xFFFU) + 1 - (y&0xFFFU), yhigh = (yn&0xFFFU) + 1;
             y += hfrac;
@@ -492,21 +537,27 @@ struct aviwriter
         }
     }
 
-    void encodeyuv(const uchar *pixels)
+    void encodeyuv(const uchar *pixels, uint start, uint end)
     {
         const int flip = -1;
         const uint planesize = videow * videoh;
-        if(!yuv) yuv = new uchar[(planesize*3)/2];
         uchar *yplane = yuv, *uplane = yuv + planesize, *vplane = yuv + planesize + planesize/4;
         const int ystride = flip*int(videow), uvstride = flip*int(videow)/2;
         if(flip < 0) { yplane -= int(videoh-1)*ystride; uplane -= int(videoh/2-1)*uvstride; vplane -= int(videoh/2-1)*uvstride; }
+        yplane += int(2*start)*ystride;
+        uplane += int(start)*uvstride;
+        vplane += int(start)*uvstride;
 
         const uint stride = videow<<2;
-        const uchar *src = pixels, *yend = src + videoh*stride;
+        const uchar *src = pixels + 2*start*stride, *yend = pixels + 2*end*stride;
         while(src < yend)    
         {
             const uchar *src2 = src + stride, *xend = src2;
             uchar *ydst = yplane, *ydst2 = yplane + ystride, *udst = uplane, *vdst = vplane;
+#ifdef __SSE2__
+            for(; src + 16 <= xend; src += 16, src2 += 16, ydst += 4, ydst2 += 4, udst += 2, vdst += 2)
+                encodeyuvsse(src, src2, ydst, ydst2, udst, vdst);
+#endif
             while(src < xend)
             {
                 const uint b1 = src[0], g1 = src[1], r1 = src[2],
@@ -539,17 +590,19 @@ struct aviwriter
         }
     }
 
-    void compressyuv(const uchar *pixels)
+    void compressyuv(const uchar *pixels, uint start, uint end)
     {
         const int flip = -1;
         const uint planesize = videow * videoh;
-        if(!yuv) yuv = new uchar[(planesize*3)/2];
         uchar *yplane = yuv, *uplane = yuv + planesize, *vplane = yuv + planesize + planesize/4;
         const int ystride = flip*int(videow), uvstride = flip*int(videow)/2;
         if(flip < 0) { yplane -= int(videoh-1)*ystride; uplane -= int(videoh/2-1)*uvstride; vplane -= int(videoh/2-1)*uvstride; }
+        yplane += int(2*start)*ystride;
+        uplane += int(start)*uvstride;
+        vplane += int(start)*uvstride;
 
         const uint stride = videow<<2;
-        const uchar *src = pixels, *yend = src + videoh*stride;
+        const uchar *src = pixels + 2*start*stride, *yend = pixels + 2*end*stride;
         while(src < yend)
         {
             const uchar *src2 = src + stride, *xend = src2;
@@ -714,20 +767,42 @@ struct aviwriter
         return true;
     }
   
-    bool writevideoframe(const uchar *pixels, uint srcw, uint srch, int format, uint frame)
+    struct yuvconvert
     {
-        if(frame < videoframes) return true;
-        
-        switch(format)
+        aviwriter *file;
+        const uchar *pixels;
+        uint srcw, srch;
+        int format;
+    };
+
+    enum { YUVSLICE = 32 }; // row pairs converted per job
+
+    static void convertyuvslice(void *data, int index, int thread)
+    {
+        const yuvconvert &c = *(const yuvconvert *)data;
+        uint start = index*YUVSLICE, end = min(start + YUVSLICE, c.file->videoh/2);
+        switch(c.format)
         {
-            case VID_RGB: 
-                if(srcw != videow || srch != videoh) scaleyuv(pixels, srcw, srch);
-                else encodeyuv(pixels);
+            case VID_RGB:
+                if(c.srcw != c.file->videow || c.srch != c.file->videoh) c.file->scaleyuv(c.pixels, c.srcw, c.srch, start, end);
+                else c.file->encodeyuv(c.pixels, start, end);
                 break;
             case VID_YUV:
-                compressyuv(pixels);
+                c.file->compressyuv(c.pixels, start, end);
                 break;
         }
+    }
+
+    bool writevideoframe(const uchar *pixels, uint srcw, uint srch, int format, uint frame)
+    {
+        if(frame < videoframes) return true;
+        
+        if(format != VID_YUV420)
+        {
+            if(!yuv) yuv = new uchar[(videow*videoh*3)/2];
+            yuvconvert c = { this, pixels, srcw, srch, format };
+            runjobs(convertyuvslice, &c, (videoh/2 + YUVSLICE - 1)/YUVSLICE);
+        }
 
         const uint framesize = (videow * videoh * 3) / 2;
         if(totalsize - segments.last().offset + framesize > 1000*1000*1000 && !nextsegment()) return false;
@@ -745,6 +820,7 @@ VAR(movieaccelblit, 0, 0, 1);
 VAR(movieaccelyuv, 0, 1, 1);
 VARP(movieaccel, 0, 1, 1);
 VARP(moviesync, 0, 0, 1);
+VARP(moviepbo, 0, 1, 1);
 FVARP(movieminquality, 0, 0, 1);
 
 namespace recorder
@@ -786,7 +862,7 @@ namespace recorder
     static queue<soundbuffer, MAXSOUNDBUFFERS> soundbuffers;
     static SDL_mutex *soundlock = NULL;
     
-    enum { MAXVIDEOBUFFERS = 2 }; // double buffer
+    enum { MAXVIDEOBUFFERS = 4 };
     struct videobuffer 
     {
         uchar *video;
@@ -814,6 +890,9 @@ namespace recorder
     static GLuint scalefb = 0, scaletex[2] = { 0, 0 };
     static uint scalew = 0, scaleh = 0;
     static GLuint encodefb = 0, encoderb = 0;
+    static GLuint readpbo = 0;
+    static uint readpbosize = 0;
+    static bool readpending = false;
 
     static SDL_Thread *thread = NULL;
     static SDL_mutex *videolock = NULL;
@@ -937,6 +1016,8 @@ namespace recorder
         }
         
         soundbuffers.clear();
+
+        numjobthreads(); // have the job workers set up before the encoder starts sharing them
         
         soundlock = SDL_CreateMutex();
         videolock = SDL_CreateMutex();
@@ -953,6 +1034,9 @@ namespace recorder
         scalew = scaleh = 0;
         if(encodefb) { glDeleteFramebuffers_(1, &encodefb); encodefb = 0; }
         if(encoderb) { glDeleteRenderbuffers_(1, &encoderb); encoderb = 0; }
+        if(readpbo) { glDeleteBuffers_(1, &readpbo); readpbo = 0; }
+        readpbosize = 0;
+        readpending = false;
     }
 
     void stop()
@@ -998,7 +1082,8 @@ namespace recorder
         glEnd();
     }
 
-    void readbuffer(videobuffer &m, uint nextframe)
+    // returns true if the pixels went to the pack buffer and still have to be fetched with finishread()
+    bool readbuffer(videobuffer &m, uint nextframe)
     {
         bool accelyuv = movieaccelyuv && renderpath!=R_FIXEDFUNCTION && !(m.w%8),
              usefbo = movieaccel && hasFBO && hasTR && file->videow <= (uint)screenw && file->videoh <= (uint)screenh && (accelyuv || file->videow < (uint)screenw || file->videoh < (uint)screenh);
@@ -1008,7 +1093,21 @@ namespace recorder
         m.format = aviwriter::VID_RGB;
         m.frame = nextframe;
 
-        glPixelStorei(GL_PACK_ALIGNMENT, texalign(m.video, m.w, 4));
+        uchar *dst = m.video;
+        bool usepbo = moviepbo && hasPBO;
+        if(usepbo)
+        {
+            if(!readpbo) glGenBuffers_(1, &readpbo);
+            glBindBuffer_(GL_PIXEL_PACK_BUFFER_ARB, readpbo);
+            if(readpbosize != m.w*m.h*4)
+            {
+                readpbosize = m.w*m.h*4;
+                glBufferData_(GL_PIXEL_PACK_BUFFER_ARB, readpbosize, NULL, GL_STREAM_READ_ARB);
+            }
+            dst = NULL; // reads now land in the pack buffer, at the same offsets they would have in m.video
+        }
+
+        glPixelStorei(GL_PACK_ALIGNMENT, texalign(dst, m.w, 4));
         if(usefbo)
         {
             uint tw = screenw, th = screenh;
@@ -1092,24 +1191,40 @@ namespace recorder
                 SETSHADER(movieu); drawquad(m.w, m.h, m.w/4, m.h/2, m.w/8, m.h/2);
                 glDisable(GL_TEXTURE_RECTANGLE_ARB);
                 const uint planesize = m.w * m.h;
-                glPixelStorei(GL_PACK_ALIGNMENT, texalign(m.video, m.w/4, 4)); 
-                glReadPixels(0, 0, m.w/4, m.h, GL_BGRA, GL_UNSIGNED_BYTE, m.video);
-                glPixelStorei(GL_PACK_ALIGNMENT, texalign(&m.video[planesize], m.w/8, 4));
-                glReadPixels(m.w/4, 0, m.w/8, m.h/2, GL_BGRA, GL_UNSIGNED_BYTE, &m.video[planesize]);
-                glPixelStorei(GL_PACK_ALIGNMENT, texalign(&m.video[planesize + planesize/4], m.w/8, 4));
-                glReadPixels(m.w/4, m.h/2, m.w/8, m.h/2, GL_BGRA, GL_UNSIGNED_BYTE, &m.video[planesize + planesize/4]);
+                glPixelStorei(GL_PACK_ALIGNMENT, texalign(dst, m.w/4, 4)); 
+                glReadPixels(0, 0, m.w/4, m.h, GL_BGRA, GL_UNSIGNED_BYTE, dst);
+                glPixelStorei(GL_PACK_ALIGNMENT, texalign(&dst[planesize], m.w/8, 4));
+                glReadPixels(m.w/4, 0, m.w/8, m.h/2, GL_BGRA, GL_UNSIGNED_BYTE, &dst[planesize]);
+                glPixelStorei(GL_PACK_ALIGNMENT, texalign(&dst[planesize + planesize/4], m.w/8, 4));
+                glReadPixels(m.w/4, m.h/2, m.w/8, m.h/2, GL_BGRA, GL_UNSIGNED_BYTE, &dst[planesize + planesize/4]);
                 m.format = aviwriter::VID_YUV420;
             }
             else
             {
                 glBindFramebuffer_(GL_FRAMEBUFFER_EXT, scalefb);
-                glReadPixels(0, 0, m.w, m.h, GL_BGRA, GL_UNSIGNED_BYTE, m.video);
+                glReadPixels(0, 0, m.w, m.h, GL_BGRA, GL_UNSIGNED_BYTE, dst);
             }
             glBindFramebuffer_(GL_FRAMEBUFFER_EXT, 0);
             glViewport(0, 0, screenw, screenh);
 
         }
-        else glReadPixels(0, 0, m.w, m.h, GL_BGRA, GL_UNSIGNED_BYTE, m.video);
+        else glReadPixels(0, 0, m.w, m.h, GL_BGRA, GL_UNSIGNED_BYTE, dst);
+
+        if(usepbo) glBindBuffer_(GL_PIXEL_PACK_BUFFER_ARB, 0);
+        return usepbo;
+    }
+
+    bool finishread(videobuffer &m)
+    {
+        glBindBuffer_(GL_PIXEL_PACK_BUFFER_ARB, readpbo);
+        const uchar *src = (const uchar *)glMapBuffer_(GL_PIXEL_PACK_BUFFER_ARB, GL_READ_ONLY_ARB);
+        if(src)
+        {
+            memcpy(m.video, src, m.format == aviwriter::VID_YUV420 ? (m.w*m.h*3)/2 : m.w*m.h*4);
+            glUnmapBuffer_(GL_PIXEL_PACK_BUFFER_ARB);
+        }
+        glBindBuffer_(GL_PIXEL_PACK_BUFFER_ARB, 0);
+        return src != NULL;
     }
  
     bool readbuffer()
@@ -1121,17 +1236,35 @@ namespace recorder
             return false;
         }
         SDL_LockMutex(videolock);
+        if(readpending)
+        {
+            // last frame's readback has had a whole frame to complete, so mapping it should not stall
+            videobuffer &m = videobuffers.adding();
+            SDL_UnlockMutex(videolock);
+            bool read = finishread(m);
+            SDL_LockMutex(videolock);
+            readpending = false;
+            if(read)
+            {
+                videobuffers.add();
+                SDL_CondSignal(shouldencode);
+            }
+        }
         if(moviesync && videobuffers.full()) SDL_CondWait(shouldread, videolock);
         uint nextframe = (max(gettime() - starttime, 0)*file->videofps)/1000;
         if(!videobuffers.full() && (lastframe == ~0U || nextframe > lastframe))
         {
             videobuffer &m = videobuffers.adding();
             SDL_UnlockMutex(videolock);
-            readbuffer(m, nextframe);
+            bool pending = readbuffer(m, nextframe);
             SDL_LockMutex(videolock);
             lastframe = nextframe;
-            videobuffers.add();
-            SDL_CondSignal(shouldencode);
+            if(pending) readpending = true;
+            else
+            {
+                videobuffers.add();
+                SDL_CondSignal(shouldencode);
+            }
         }
         SDL_UnlockMutex(videolock);
         return true;
@@ -1785,6 +1785,7 @@ void allchanged(bool load)
     entitiesinoctanodes();
     tjoints.setsize(0);
     if(filltjoints) findtjoints();
+    if(load) preloadslots();
     octarender();
     if(load) precachetextures();
     setupmaterials();
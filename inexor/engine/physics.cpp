@@ -401,6 +401,65 @@ float shadowray(ShadowRayCache *cache, const vec &o, const vec &ray, float radiu
     }
 }
 
+// RAY_CLIPMAT|RAY_POLY has no RAY_BB, so like raycube the los test never descends into entities
+static inline float losent(octaentities *oc, const vec &o, const vec &ray, float radius, int mode, extentity *t)
+{
+    return radius;
+}
+
+// same as raycube with RAY_CLIPMAT|RAY_POLY, but only touches the given cache
+static float losray(ShadowRayCache *cache, const vec &o, const vec &ray, float radius)
+{
+    const int mode = RAY_CLIPMAT|RAY_POLY;
+    extentity *t = NULL;
+
+    INITRAYCUBE;
+    CHECKINSIDEWORLD;
+
+    int x = int(v.x), y = int(v.y), z = int(v.z);
+    for(;;)
+    {
+        DOWNOCTREE(losent, if(mode&RAY_SHADOW));
+
+        int lsize = 1<<lshift;
+
+        cube &c = *lc;
+        if(isclipped(c.material&MATF_VOLUME) || isentirelysolid(c) || dent < dist) return min(dent, dist);
+
+        ivec lo(x&(~0<<lshift), y&(~0<<lshift), z&(~0<<lshift));
+
+        if(!isempty(c))
+        {
+            clipplanes &p = cache->clipcache[int(&c - worldroot)&(MAXCLIPPLANES-1)];
+            if(p.owner != &c || p.version != cache->version) { p.owner = &c; p.version = cache->version; genclipplanes(c, lo.x, lo.y, lo.z, lsize, p, false); }
+            INTERSECTPLANES(, goto nextcube);
+            INTERSECTBOX(, goto nextcube);
+            if(exitdist >= 0) return min(dent, dist+max(enterdist+0.1f, 0.0f));
+        }
+
+    nextcube:
+        FINDCLOSEST(, , );
+
+        if(dist>=radius) return min(dent, dist);
+
+        UPOCTREE(return min(dent, radius));
+    }
+}
+
+// thread safe version of raycubelos, returns -1 for a degenerate ray that has to be tested on the main thread
+int raycubelos(ShadowRayCache *cache, const vec &o, const vec &dest, vec &hitpos)
+{
+    vec ray(dest);
+    ray.sub(o);
+    float mag = ray.magnitude();
+    if(mag <= 0) return -1;
+    ray.mul(1/mag);
+    float dist = losray(cache, o, ray, mag);
+    if(dist >= mag) dist = mag;
+    hitpos = vec(ray).mul(dist).add(o);
+    return dist >= mag ? 1 : 0;
+}
+
 float rayent(const vec &o, const vec &ray, float radius, int mode, int size, int &orient, int &ent)
 {
     hitent = -1;
@@ -605,8 +605,28 @@ static inline bool sorttransparentmodels(const transparentmodel &x, const transp
     return x.dist < y.dist;
 }
 
+// animates every visible skeletal model ahead of rendering so their skeletons can be evaluated across the job threads
+static void prepassmodelbatches()
+{
+    animmodel::prepass = true;
+    loopi(numbatches)
+    {
+        modelbatch &b = *batches[i];
+        if(!b.m->skeletal()) continue;
+        loopvj(b.batched)
+        {
+            batchedmodel &bm = b.batched[j];
+            if(bm.flags&MDL_CULL_VFC) continue;
+            b.m->render(bm.anim|ANIM_NORENDER, bm.basetime, bm.basetime2, bm.pos, bm.yaw, bm.pitch, bm.d, bm.attached>=0 ? &modelattached[bm.attached] : NULL, bm.color, bm.dir, bm.transparent);
+        }
+    }
+    animmodel::prepass = false;
+    skelmodel::flushskeljobs();
+}
+
 void endmodelbatches()
 {
+    if(numjobthreads() > 1) prepassmodelbatches();
     vector<transparentmodel> transparent;
     loopi(numbatches)
     {
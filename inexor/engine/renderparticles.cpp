@@ -608,6 +608,8 @@ inline void seedpos<PT_TRAIL>(particleemitter &pe, const vec &o, const vec &d, i
     pe.extendbb(e, size); 
 }
 
+#define PARTJOBSIZE 1024
+
 template<int T>
 struct varenderer : partrenderer
 {
@@ -759,28 +761,40 @@ struct varenderer : partrenderer
         else genpos<T>(o, d, p->size, ts, p->gravity, vs);
     }
 
+    void genverts(int start, int end)
+    {
+        for(int i = start; i < end; i++)
+        {
+            particle *p = &parts[i];
+            genverts(p, &verts[i*4], (p->flags&0x80)!=0);
+        }
+    }
+
+    static void genvertsjob(void *data, int index, int thread)
+    {
+        varenderer *r = (varenderer *)data;
+        int start = index*PARTJOBSIZE;
+        r->genverts(start, min(start + PARTJOBSIZE, r->numparts));
+    }
+
     void update()
     {
         if(lastmillis == lastupdate) return;
         lastupdate = lastmillis;
       
+        // drop the particles that expired last pass first, so the survivors can be generated independently
         loopi(numparts)
         {
-            particle *p = &parts[i];
-            partvert *vs = &verts[i*4];
-            if(p->fade < 0)
-            {
-                do 
-                {
-                    --numparts; 
-                    if(numparts <= i) return;
-                }
-                while(parts[numparts].fade < 0);
-                *p = parts[numparts];
-                genverts(p, vs, true);
-            }
-            else genverts(p, vs, (p->flags&0x80)!=0);
+            if(parts[i].fade >= 0) continue;
+            while(--numparts > i && parts[numparts].fade < 0);
+            if(numparts <= i) break;
+            parts[i] = parts[numparts];
+            parts[i].flags |= 0x80;
         }
+
+        // collisions add decals and tracking calls into the game, so those have to stay on this thread
+        if(collide || type&PT_TRACK) genverts(0, numparts);
+        else runjobs(genvertsjob, this, (numparts + PARTJOBSIZE - 1)/PARTJOBSIZE);
     }
     
     void render()
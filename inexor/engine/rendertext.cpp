@@ -9,8 +9,56 @@ static int fontdeftex = 0;
 font *curfont = NULL;
 int curfonttex = 0;
 
+VARP(textcachesize, 0, 512, 8192);
+
+struct textquad
+{
+    float x1, y1, x2, y2, tx1, ty1, tx2, ty2;
+};
+
+// consecutive quads sharing a font texture and color
+struct textrun
+{
+    int tex, numquads;
+    char color;
+};
+
+// the laid out glyphs of a string, so text that doesn't change isn't walked again every frame
+struct textlayout
+{
+    char *str;
+    font *f;
+    int maxwidth, lastused;
+    bool usecolor;
+    float width, height;
+    vector<textquad> quads;
+    vector<textrun> runs;
+
+    textlayout() : str(NULL) {}
+    ~textlayout() { DELETEA(str); }
+};
+
+struct textkey
+{
+    const char *str;
+    font *f;
+    int maxwidth;
+    bool usecolor;
+};
+
+static inline uint hthash(const textkey &k) { return hthash(k.str) ^ (uint(size_t(k.f))>>4) ^ (uint(k.maxwidth)<<1) ^ uint(k.usecolor); }
+static inline bool htcmp(const textkey &k, const textlayout &l) { return k.f == l.f && k.maxwidth == l.maxwidth && k.usecolor == l.usecolor && !strcmp(k.str, l.str); }
+
+static hashset<textlayout> textlayouts;
+
+static void cleartextlayouts()
+{
+    textlayouts.clear();
+}
+
 void newfont(char *name, char *tex, int *defaultw, int *defaulth)
 {
+    cleartextlayouts();
     font *f = &fonts[name];
     if(!f->name) f->name = newstring(name);
     f->texs.shrink(0);
@@ -32,6 +80,7 @@ void newfont(char *name, char *tex, int *defaultw, int *defaulth)
 void fontoffset(char *c)
 {
     if(!fontdef) return;
+    cleartextlayouts();
     
     fontdef->charoffset = c[0];
 }
@@ -39,6 +88,7 @@ void fontoffset(char *c)
 void fontscale(int *scale)
 {
     if(!fontdef) return;
+    cleartextlayouts();
 
     fontdef->scale = *scale > 0 ? *scale : fontdef->defaulth; 
 }
@@ -61,6 +111,7 @@ void fonttex(char *s)
 void fontchar(int *x, int *y, int *w, int *h, int *offsetx, int *offsety, int *advance)
 {
     if(!fontdef) return;
+    cleartextlayouts();
 
     font::charinfo &c = fontdef->chars.add();
     c.x = *x;
@@ -76,6 +127,7 @@ void fontchar(int *x, int *y, int *w, int *h, int *offsetx, int *offsety, int *a
 void fontskip(int *n)
 {
     if(!fontdef) return;
+    cleartextlayouts();
     loopi(max(*n, 1))
     {
         font::charinfo &c = fontdef->chars.add();
@@ -94,6 +146,7 @@ void fontalias(const char *dst, const char *src)
 {
     font *s = fonts.access(src);
     if(!s) return;
+    cleartextlayouts();
     font *d = &fonts[dst];
     if(!d->name) d->name = newstring(dst);
     d->texs = s->texs;
@@ -178,6 +231,26 @@ void draw_textf(const char *fstr, int left, int top, ...)
     draw_text(str, left, top);
 }
 
+static inline void makecharquad(textquad &q, const font::charinfo &info, Texture *tex, float x, float y, float scale)
+{
+    q.x1 = x + scale*info.offsetx;
+    q.y1 = y + scale*info.offsety;
+    q.x2 = x + scale*(info.offsetx + info.w);
+    q.y2 = y + scale*(info.offsety + info.h);
+    q.tx1 = info.x / float(tex->xs);
+    q.ty1 = info.y / float(tex->ys);
+    q.tx2 = (info.x + info.w) / float(tex->xs);
+    q.ty2 = (info.y + info.h) / float(tex->ys);
+}
+
+static inline void drawcharquad(const textquad &q, float left, float top)
+{
+    varray::attrib<float>(left + q.x1, top + q.y1); varray::attrib<float>(q.tx1, q.ty1);
+    varray::attrib<float>(left + q.x2, top + q.y1); varray::attrib<float>(q.tx2, q.ty1);
+    varray::attrib<float>(left + q.x2, top + q.y2); varray::attrib<float>(q.tx2, q.ty2);
+    varray::attrib<float>(left + q.x1, top + q.y2); varray::attrib<float>(q.tx1, q.ty2);
+}
+
 static float draw_char(Texture *&tex, int c, float x, float y, float scale)
 {
     font::charinfo &info = curfont->chars[c-curfont->charoffset];
@@ -188,50 +261,50 @@ static float draw_char(Texture *&tex, int c, float x, float y, float scale)
         glBindTexture(GL_TEXTURE_2D, tex->id);
     }
 
-    float x1 = x + scale*info.offsetx,
-          y1 = y + scale*info.offsety,
-          x2 = x + scale*(info.offsetx + info.w),
-          y2 = y + scale*(info.offsety + info.h),
-          tx1 = info.x / float(tex->xs),
-          ty1 = info.y / float(tex->ys),
-          tx2 = (info.x + info.w) / float(tex->xs),
-          ty2 = (info.y + info.h) / float(tex->ys);
-
-    varray::attrib<float>(x1, y1); varray::attrib<float>(tx1, ty1);
-    varray::attrib<float>(x2, y1); varray::attrib<float>(tx2, ty1);
-    varray::attrib<float>(x2, y2); varray::attrib<float>(tx2, ty2);
-    varray::attrib<float>(x1, y2); varray::attrib<float>(tx1, ty2);
+    textquad q;
+    makecharquad(q, info, tex, x, y, scale);
+    drawcharquad(q, 0, 0);
 
     return scale*info.advance;
 }
 
-//stack[sp] is current color index
-static void text_color(char c, char *stack, int size, int &sp, bvec color, int a) 
+static bvec textcolor(char c, const bvec &color)
+{
+    switch(c)
+    {
+        case '0': return bvec( 64, 255, 128);   // green: player talk
+        case '1': return bvec( 96, 160, 255);   // blue: "echo" command
+        case '2': return bvec(255, 192,  64);   // yellow: gameplay messages 
+        case '3': return bvec(255,  64,  64);   // red: important errors
+        case '4': return bvec(128, 128, 128);   // gray
+        case '5': return bvec(192,  64, 192);   // magenta
+        case '6': return bvec(255, 128,   0);   // orange
+        case '7': return bvec(255, 255, 255);   // white
+        default: return color;                  // provided color: everything else
+    }
+}
+
+//stack[sp] is current color index, returns the color code now in effect
+static char text_colorcode(char c, char *stack, int size, int &sp)
 {
     if(c=='s') // save color
     {   
         c = stack[sp];
         if(sp<size-1) stack[++sp] = c;
+        return 0;
     }
-    else
-    {
-        xtraverts += varray::end();
-        if(c=='r') { if(sp > 0) --sp; c = stack[sp]; } // restore color
-        else stack[sp] = c;
-        switch(c)
-        {
-            case '0': color = bvec( 64, 255, 128); break;   // green: player talk
-            case '1': color = bvec( 96, 160, 255); break;   // blue: "echo" command
-            case '2': color = bvec(255, 192,  64); break;   // yellow: gameplay messages 
-            case '3': color = bvec(255,  64,  64); break;   // red: important errors
-            case '4': color = bvec(128, 128, 128); break;   // gray
-            case '5': color = bvec(192,  64, 192); break;   // magenta
-            case '6': color = bvec(255, 128,   0); break;   // orange
-            case '7': color = bvec(255, 255, 255); break;   // white
-            // provided color: everything else
-        }
-        glColor4ub(color.x, color.y, color.z, a);
-    } 
+    if(c=='r') { if(sp > 0) --sp; c = stack[sp]; } // restore color
+    else stack[sp] = c;
+    return c;
+}
+
+static void text_color(char c, char *stack, int size, int &sp, bvec color, int a) 
+{
+    c = text_colorcode(c, stack, size, sp);
+    if(!c) return;
+    xtraverts += varray::end();
+    color = textcolor(c, color);
+    glColor4ub(color.x, color.y, color.z, a);
 }
 
 #define TEXTSKELETON \
@@ -283,6 +356,112 @@ static void text_color(char c, char *stack, int size, int &sp, bvec color, int a
 
 #define TEXTEND(cursor) if(cursor >= i) { do { TEXTINDEX(cursor); } while(0); }
 
+static void layout_char(textlayout &l, int c, float x, float y, float scale, char color)
+{
+    const font::charinfo &info = curfont->chars[c-curfont->charoffset];
+    if(l.runs.empty() || l.runs.last().tex != info.tex || l.runs.last().color != color)
+    {
+        textrun &run = l.runs.add();
+        run.tex = info.tex;
+        run.color = color;
+        run.numquads = 0;
+    }
+    l.runs.last().numquads++;
+    makecharquad(l.quads.add(), info, curfont->texs[info.tex], x, y, scale);
+}
+
+static void layout_text(textlayout &l)
+{
+    #define TEXTINDEX(idx)
+    #define TEXTWHITE(idx)
+    #define TEXTLINE(idx) if(x > l.width) l.width = x;
+    #define TEXTCOLOR(idx) if(l.usecolor) { char code = text_colorcode(str[idx], colorstack, sizeof(colorstack), colorpos); if(code) color = code; }
+    #define TEXTCHAR(idx) layout_char(l, c, x, y, scale, color); x += cw;
+    #define TEXTWORD { float wordx = x + w; TEXTWORDSKELETON x = wordx; }
+    const char *str = l.str;
+    int maxwidth = l.maxwidth;
+    char colorstack[10], color = 'c'; //indicate user color
+    colorstack[0] = color;
+    int colorpos = 0;
+    l.width = 0;
+    TEXTSKELETON
+    l.height = y + FONTH;
+    TEXTLINE(_)
+    #undef TEXTINDEX
+    #undef TEXTWHITE
+    #undef TEXTLINE
+    #undef TEXTCOLOR
+    #undef TEXTCHAR
+    #undef TEXTWORD
+}
+
+// drops the layouts that weren't used this frame, or all of them if every one was
+static void prunetextlayouts()
+{
+    vector<textlayout *> stale;
+    enumerate(textlayouts, textlayout, l, if(l.lastused != totalmillis) stale.add(&l));
+    if(stale.empty()) { cleartextlayouts(); return; }
+    loopv(stale)
+    {
+        textlayout &l = *stale[i];
+        textkey key = { l.str, l.f, l.maxwidth, l.usecolor };
+        textlayouts.remove(key);
+    }
+}
+
+static textlayout *gettextlayout(const char *str, int maxwidth, bool usecolor)
+{
+    if(!textcachesize) return NULL;
+    textkey key = { str, curfont, maxwidth, usecolor };
+    textlayout *l = textlayouts.access(key);
+    if(!l)
+    {
+        if(textlayouts.numelems >= textcachesize) prunetextlayouts();
+        l = &textlayouts[key];
+        l->str = newstring(str);
+        l->f = curfont;
+        l->maxwidth = maxwidth;
+        l->usecolor = usecolor;
+        layout_text(*l);
+    }
+    l->lastused = totalmillis;
+    return l;
+}
+
+static void draw_textlayout(const textlayout &l, int left, int top, const bvec &usercolor, int a)
+{
+    Texture *tex = curfont->texs[0];
+    char color = 'c';
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glBindTexture(GL_TEXTURE_2D, tex->id);
+    glColor4ub(usercolor.x, usercolor.y, usercolor.z, a);
+    varray::enable();
+    varray::defattrib(varray::ATTRIB_VERTEX, 2, GL_FLOAT);
+    varray::defattrib(varray::ATTRIB_TEXCOORD0, 2, GL_FLOAT);
+    varray::begin(GL_QUADS);
+    const textquad *q = l.quads.getbuf();
+    loopv(l.runs)
+    {
+        const textrun &run = l.runs[i];
+        if(tex != curfont->texs[run.tex])
+        {
+            xtraverts += varray::end();
+            tex = curfont->texs[run.tex];
+            glBindTexture(GL_TEXTURE_2D, tex->id);
+        }
+        if(color != run.color)
+        {
+            xtraverts += varray::end();
+            color = run.color;
+            bvec c = textcolor(color, usercolor);
+            glColor4ub(c.x, c.y, c.z, a);
+        }
+        loopj(run.numquads) drawcharquad(*q++, left, top);
+    }
+    xtraverts += varray::end();
+    varray::disable();
+}
+
 int text_visible(const char *str, float hitx, float hity, int maxwidth)
 {
     #define TEXTINDEX(idx)
@@ -329,6 +508,8 @@ void text_boundsf(const char *str, float &width, float &height, int maxwidth)
     #define TEXTCOLOR(idx)
     #define TEXTCHAR(idx) x += cw;
     #define TEXTWORD x += w;
+    textlayout *l = gettextlayout(str, maxwidth, true);
+    if(l) { width = l->width; height = l->height; return; }
     width = 0;
     TEXTSKELETON
     height = y + FONTH;
@@ -349,6 +530,11 @@ void draw_text(const char *str, int left, int top, int r, int g, int b, int a, i
     #define TEXTCOLOR(idx) if(usecolor) text_color(str[idx], colorstack, sizeof(colorstack), colorpos, color, a);
     #define TEXTCHAR(idx) draw_char(tex, c, left+x, top+y, scale); x += cw;
     #define TEXTWORD TEXTWORDSKELETON
+    if(cursor < 0)
+    {
+        textlayout *l = gettextlayout(str, maxwidth, a >= 0);
+        if(l) { draw_textlayout(*l, left, top, bvec(r, g, b), abs(a)); return; }
+    }
     char colorstack[10];
     colorstack[0] = 'c'; //indicate user color
     bvec color(r, g, b);
@@ -1090,13 +1090,16 @@ void initserver(bool listen, bool dedicated)
     
     execfile("server-init.cfg", false);
 
-    if(listen) setuplistenserver(dedicated);
+    if(listen)
+    {
+        dedicatedserver = dedicated;
+        setuplistenserver(dedicated);
+    }
 
     server::serverinit();
 
     if(listen)
     {
-        dedicatedserver = dedicated;
         updatemasterserver();
         if(dedicated) rundedicatedserver(); // never returns
 #ifndef STANDALONE
@@ -268,11 +268,11 @@ struct serverinfo : pingattempts
     int pings[MAXPINGS];
     vector<int> attr;
     ENetAddress address;
-    bool keep;
+    bool keep, compatible;
     const char *password;
 
     serverinfo()
-        : port(-1), numplayers(0), resolved(UNRESOLVED), keep(false), password(NULL)
+        : port(-1), numplayers(0), resolved(UNRESOLVED), keep(false), compatible(false), password(NULL)
     {
         name[0] = map[0] = sdesc[0] = '\0';
         clearpings();
@@ -298,6 +298,13 @@ struct serverinfo : pingattempts
         clearpings();
         attr.setsize(0);
         numplayers = 0;
+        checkcompatible();
+    }
+
+    /// cached for sorting, which would otherwise ask the game module on every comparison
+    void checkcompatible()
+    {
+        compatible = server::servercompatible(name, sdesc, map, ping, attr, numplayers);
     }
 
     void reset()
@@ -305,11 +312,16 @@ struct serverinfo : pingattempts
         lastping = -1;
     }
 
-    void checkdecay(int decay)
+    bool checkdecay(int decay)
     {
+        bool decayed = false;
         if(lastping >= 0 && totalmillis - lastping >= decay)
+        {
             cleanup();
+            decayed = true;
+        }
         if(lastping < 0) lastping = totalmillis;
+        return decayed;
     }
 
     void calcping()
@@ -329,8 +341,7 @@ struct serverinfo : pingattempts
 
     static bool compare(serverinfo *a, serverinfo *b)
     {
-        bool ac = server::servercompatible(a->name, a->sdesc, a->map, a->ping, a->attr, a->numplayers),
-             bc = server::servercompatible(b->name, b->sdesc, b->map, b->ping, b->attr, b->numplayers);
+        bool ac = a->compatible, bc = b->compatible;
         if(ac > bc) return true;
         if(bc > ac) return false;
         if(a->keep > b->keep) return true;
@@ -348,15 +359,57 @@ struct serverinfo : pingattempts
 };
 
 vector<serverinfo *> servers;
+/// servers deleted while their name was being looked up, freed once the resolver hands the name back
+vector<serverinfo *> deletedservers;
 ENetSocket pingsock = ENET_SOCKET_NULL;
 int lastinfo = 0;
 
+static inline uint hthash(const ENetAddress &a)
+{
+    return a.host ^ (uint(a.port) << 16);
+}
+
+static inline bool htcmp(const ENetAddress &x, const ENetAddress &y)
+{
+    return x.host == y.host && x.port == y.port;
+}
+
+/// ping replies are matched to servers through this index, which is rebuilt whenever servers are added,
+/// removed or resolved
+hashtable<ENetAddress, serverinfo *> serveraddresses;
+bool serveraddressesdirty = true;
+/// set when servers were added or removed (full sort) or their info changed (the old order is nearly sorted)
+bool serverlistchanged = true, serverinfochanged = false;
+bool resolvepending = false;
+
+static serverinfo *findserver(const ENetAddress &address)
+{
+    if(serveraddressesdirty)
+    {
+        serveraddresses.clear();
+        loopv(servers)
+        {
+            serverinfo *si = servers[i];
+            if(si->address.host != ENET_HOST_ANY && !serveraddresses.access(si->address)) serveraddresses[si->address] = si;
+        }
+        serveraddressesdirty = false;
+    }
+    serverinfo **si = serveraddresses.access(address);
+    return si ? *si : NULL;
+}
+
+static void serverschanged()
+{
+    serveraddressesdirty = serverlistchanged = true;
+}
+
 static serverinfo *newserver(const char *name, int port, uint ip = ENET_HOST_ANY)
 {
     serverinfo *si = new serverinfo;
     si->address.host = ip;
     si->address.port = server::serverinfoport(port);
     if(ip!=ENET_HOST_ANY) si->resolved = RESOLVED;
+    else resolvepending = true;
 
     si->port = port;
     if(name) copystring(si->name, name);
@@ -367,7 +420,9 @@ static serverinfo *newserver(const char *name, int port, uint ip = ENET_HOST_ANY
 
     }
 
+    si->checkcompatible();
     servers.add(si);
+    serverschanged();
 
     return si;
 }
@@ -396,7 +451,8 @@ void addserver(const char *name, int port, const char *password, bool keep)
 VARP(searchlan, 0, 0, 1);
 VARP(servpingrate, 1000, 5000, 60000);
 VARP(servpingdecay, 1000, 15000, 60000);
-VARP(maxservpings, 0, 10, 1000);
+/// most pings sent per frame, 0 for no limit
+VARP(maxservpings, 0, 100, 10000);
 
 pingattempts lanpings;
 
@@ -427,9 +483,16 @@ void pingservers()
     ENetBuffer buf;
     uchar ping[MAXTRANS];
 
-    static int lastping = 0;
+    // every server is pinged once per servpingrate, so the number of pings per frame follows the length
+    // of the list and the time since the last frame; a new list goes out as fast as maxservpings allows
+    static int lastping = 0, lastlanping = -1;
+    static float pingcredit = 0;
     if(lastping >= servers.length()) lastping = 0;
-    loopi(maxservpings ? min(servers.length(), maxservpings) : servers.length())
+    pingcredit = min(pingcredit + servers.length()*float(totalmillis - lastinfo)/servpingrate, float(servers.length()));
+    int numpings = int(pingcredit);
+    if(maxservpings) numpings = min(numpings, maxservpings);
+    pingcredit -= numpings;
+    loopi(numpings)
     {
         serverinfo &si = *servers[lastping];
         if(++lastping >= servers.length()) lastping = 0;
@@ -437,21 +500,23 @@ void pingservers()
         buildping(buf, ping, si);
         enet_socket_send(pingsock, &si.address, &buf, 1);
         
-        si.checkdecay(servpingdecay);
+        if(si.checkdecay(servpingdecay)) serverinfochanged = true;
     }
-    if(searchlan)
+    if(searchlan && (lastlanping < 0 || totalmillis - lastlanping >= servpingrate))
     {
         ENetAddress address;
         address.host = ENET_HOST_BROADCAST;
         address.port = server::laninfoport();
         buildping(buf, ping, lanpings);
         enet_socket_send(pingsock, &address, &buf, 1);
+        lastlanping = totalmillis;
     }
     lastinfo = totalmillis;
 }
   
 void checkresolver()
 {
+    if(!resolvepending) return;
     int resolving = 0;
     loopv(servers)
     {
@@ -463,13 +528,21 @@ void checkresolver()
             resolving++;
         }
     }
-    if(!resolving) return;
+    resolving += deletedservers.length();
+    if(!resolving) { resolvepending = false; return; }
 
     const char *name = NULL;
     for(;;)
     {
         ENetAddress addr = { ENET_HOST_ANY, ENET_PORT_ANY };
         if(!resolvercheck(&name, &addr)) break;
+        loopv(deletedservers) if(name == deletedservers[i]->name)
+        {
+            delete deletedservers.remove(i);
+            name = NULL;
+            break;
+        }
+        if(!name) continue;
         loopv(servers)
         {
             serverinfo &si = *servers[i];
@@ -477,6 +550,7 @@ void checkresolver()
             {
                 si.resolved = RESOLVED; 
                 si.address.host = addr.host;
+                serveraddressesdirty = true;
                 break;
             }
         }
@@ -501,8 +575,7 @@ void checkpings()
         if(len <= 0) return;  
         ucharbuf p(ping, len);
         int millis = getint(p);
-        serverinfo *si = NULL;
-        loopv(servers) if(addr.host == servers[i]->address.host && addr.port == servers[i]->address.port) { si = servers[i]; break; }
+        serverinfo *si = findserver(addr);
         if(si)
         {
             if(!si->checkattempt(millis)) continue;
@@ -524,15 +597,30 @@ void checkpings()
         filtertext(si->map, text, false);
         getstring(text, p);
         filtertext(si->sdesc, text);
+        si->checkcompatible();
+        serverinfochanged = true;
     }
 }
 
 void sortservers()
 {
     servers.sort(serverinfo::compare);
+    serverlistchanged = serverinfochanged = false;
 }
 COMMAND(sortservers, "");
 
+/// only reorders what changed since the last sort: a few updated servers in an otherwise sorted list
+/// are moved into place by insertion sort in about linear time
+void updateserverorder()
+{
+    if(serverlistchanged) sortservers();
+    else if(serverinfochanged)
+    {
+        insertionsort(servers.getbuf(), servers.length(), serverinfo::compare);
+        serverinfochanged = false;
+    }
+}
+
 VARP(autosortservers, 0, 1, 1);
 VARP(autoupdateservers, 0, 1, 1);
 
@@ -549,8 +637,8 @@ void refreshservers()
 
     checkresolver();
     checkpings();
-    if(totalmillis - lastinfo >= servpingrate/(maxservpings ? max(1, (servers.length() + maxservpings - 1) / maxservpings) : 1)) pingservers();
-    if(autosortservers) sortservers();
+    pingservers();
+    if(autosortservers) updateserverorder();
 }
 
 serverinfo *selectedserver = NULL;
@@ -602,12 +690,38 @@ void connectselected()
 
 COMMAND(connectselected, "");
 
+/// the version of the last server list received from the master, so that the next update
+/// only needs the servers that were added or removed since
+int serverlistversion = 0;
+string serverlistmaster = "";
+
 void clearservers(bool full = false)
 {
     resolverclear();
+    deletedservers.deletecontents();
     if(full) servers.deletecontents();
     else loopvrev(servers) if(!servers[i]->keep) delete servers.remove(i);
     selectedserver = NULL;
+    // a delta against the cleared list would leave out every server that did not change
+    serverlistversion = 0;
+    serverschanged();
+}
+
+void delserver(const char *name, int port)
+{
+    if(port <= 0) port = server::serverport();
+    loopv(servers)
+    {
+        serverinfo *s = servers[i];
+        if(strcmp(s->name, name) || s->port != port || s->keep) continue;
+        if(selectedserver == s) selectedserver = NULL;
+        servers.remove(i);
+        // names still being looked up are referenced by the resolver threads
+        if(s->resolved == RESOLVING) deletedservers.add(s);
+        else delete s;
+        serverschanged();
+        return;
+    }
 }
 
 #define RETRIEVELIMIT 20000
@@ -622,7 +736,9 @@ void retrieveservers(vector<char> &data)
     renderprogress(0, text);
 
     int starttime = SDL_GetTicks(), timeout = 0;
-    const char *req = "list\n";
+    string request = "list\n";
+    if(serverlistversion) formatstring(request)("listversion %d\nlist\n", serverlistversion);
+    const char *req = request;
     int reqlen = strlen(req);
     ENetBuffer buf;
     while(reqlen > 0)
@@ -670,12 +786,20 @@ bool updatedservers = false;
 
 void updatefrommaster()
 {
+    extern char *mastername;
+    if(strcmp(serverlistmaster, mastername))
+    {
+        copystring(serverlistmaster, mastername);
+        serverlistversion = 0;
+    }
     vector<char> data;
     retrieveservers(data);
     if(data.empty()) conoutf("master server not replying");
     else
     {
-        clearservers();
+        // a delta only names the servers that changed, everything else replaces the list
+        if(strncmp(data.getbuf(), "serverlistdelta", strlen("serverlistdelta"))) clearservers();
+        serverlistversion = 0;
         execute(data.getbuf());
     }
     refreshservers();
@@ -692,6 +816,10 @@ ICOMMAND(addserver, "sis", (const char *name, int *port, const char *password),
 ICOMMAND(keepserver, "sis", (const char *name, int *port, const char *password), addserver(name, *port, password[0] ? password : NULL, true));
 ICOMMAND(clearservers, "i", (int *full), clearservers(*full!=0));
 COMMAND(updatefrommaster, "");
+ICOMMAND(delserver, "si", (const char *name, int *port), delserver(name, *port));
+ICOMMAND(serverlistversion, "i", (int *version), serverlistversion = *version);
+/// marks a reply that only lists the changes since the given version, see updatefrommaster()
+ICOMMAND(serverlistdelta, "i", (int *version), {});
 COMMAND(initservers, "");
 
 void writeservercfg()
@@ -4,10 +4,132 @@ VARP(matskel, 0, 1, 1);
 VAR(maxskelanimdata, 1, 192, 0);
 VAR(testtags, 0, 0, 1);
 
+VARP(skelquant, 0, 0, 64); // number of steps each frame interpolation is snapped to, so nearby poses share a cache entry
+VARP(maxskelcache, 1, 32, 1024); // poses kept per skeleton from one frame to the next, a frame that draws more keeps them until it is over
+
+static int skelcachehits = 0, skelcachemisses = 0;
+
+ICOMMAND(skelcachestats, "", (),
+{
+    int lookups = skelcachehits + skelcachemisses;
+    conoutf("skeleton cache: %d hits, %d misses (%d%% hit rate)", skelcachehits, skelcachemisses, lookups ? skelcachehits*100/lookups : 0);
+    skelcachehits = skelcachemisses = 0;
+});
+
 #define BONEMASK_NOT  0x8000
 #define BONEMASK_END  0xFFFF
 #define BONEMASK_BONE 0x7FFF
 
+#ifdef __SSE__
+#include <xmmintrin.h>
+
+// CPU skinning 4 vertices at a time: the bones of 4 vertices are gathered and transposed,
+// so that each register holds the same component for all 4, and the math below then
+// follows the scalar vec/quat code operation for operation
+
+static inline void loadsse(const float *a, const float *b, const float *c, const float *d, __m128 &x, __m128 &y, __m128 &z, __m128 &w)
+{
+    x = _mm_loadu_ps(a);
+    y = _mm_loadu_ps(b);
+    z = _mm_loadu_ps(c);
+    w = _mm_loadu_ps(d);
+    _MM_TRANSPOSE4_PS(x, y, z, w);
+}
+
+static inline void storesse(float *a, float *b, float *c, float *d, __m128 x, __m128 y, __m128 z)
+{
+    __m128 w = _mm_setzero_ps();
+    _MM_TRANSPOSE4_PS(x, y, z, w);
+    _mm_storel_pi((__m64 *)a, x); _mm_store_ss(a+2, _mm_movehl_ps(x, x));
+    _mm_storel_pi((__m64 *)b, y); _mm_store_ss(b+2, _mm_movehl_ps(y, y));
+    _mm_storel_pi((__m64 *)c, z); _mm_store_ss(c+2, _mm_movehl_ps(z, z));
+    _mm_storel_pi((__m64 *)d, w); _mm_store_ss(d+2, _mm_movehl_ps(w, w));
+}
+
+static inline void crosssse(__m128 ax, __m128 ay, __m128 az, __m128 bx, __m128 by, __m128 bz, __m128 &x, __m128 &y, __m128 &z)
+{
+    x = _mm_sub_ps(_mm_mul_ps(ay, bz), _mm_mul_ps(az, by));
+    y = _mm_sub_ps(_mm_mul_ps(az, bx), _mm_mul_ps(ax, bz));
+    z = _mm_sub_ps(_mm_mul_ps(ax, by), _mm_mul_ps(ay, bx));
+}
+
+template<class B> struct bonesse;
+
+template<> struct bonesse<dualquat>
+{
+    __m128 rx, ry, rz, rw, dx, dy, dz, dw;
+
+    bonesse(const dualquat &a, const dualquat &b, const dualquat &c, const dualquat &d)
+    {
+        loadsse(&a.real.x, &b.real.x, &c.real.x, &d.real.x, rx, ry, rz, rw);
+        loadsse(&a.dual.x, &b.dual.x, &c.dual.x, &d.dual.x, dx, dy, dz, dw);
+    }
+
+    void rotate(__m128 &x, __m128 &y, __m128 &z) const
+    {
+        __m128 tx, ty, tz, ux, uy, uz;
+        crosssse(rx, ry, rz, x, y, z, tx, ty, tz);
+        tx = _mm_add_ps(tx, _mm_mul_ps(x, rw));
+        ty = _mm_add_ps(ty, _mm_mul_ps(y, rw));
+        tz = _mm_add_ps(tz, _mm_mul_ps(z, rw));
+        crosssse(rx, ry, rz, tx, ty, tz, ux, uy, uz);
+        __m128 two = _mm_set1_ps(2);
+        x = _mm_add_ps(_mm_mul_ps(ux, two), x);
+        y = _mm_add_ps(_mm_mul_ps(uy, two), y);
+        z = _mm_add_ps(_mm_mul_ps(uz, two), z);
+    }
+
+    void transform(__m128 &x, __m128 &y, __m128 &z) const
+    {
+        __m128 tx, ty, tz, ux, uy, uz;
+        crosssse(rx, ry, rz, x, y, z, tx, ty, tz);
+        tx = _mm_add_ps(_mm_add_ps(tx, _mm_mul_ps(x, rw)), dx);
+        ty = _mm_add_ps(_mm_add_ps(ty, _mm_mul_ps(y, rw)), dy);
+        tz = _mm_add_ps(_mm_add_ps(tz, _mm_mul_ps(z, rw)), dz);
+        crosssse(rx, ry, rz, tx, ty, tz, ux, uy, uz);
+        __m128 two = _mm_set1_ps(2);
+        x = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(_mm_add_ps(ux, _mm_mul_ps(dx, rw)), _mm_mul_ps(rx, dw)), two), x);
+        y = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(_mm_add_ps(uy, _mm_mul_ps(dy, rw)), _mm_mul_ps(ry, dw)), two), y);
+        z = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(_mm_add_ps(uz, _mm_mul_ps(dz, rw)), _mm_mul_ps(rz, dw)), two), z);
+    }
+
+    void transformnormal(__m128 &x, __m128 &y, __m128 &z) const { rotate(x, y, z); }
+};
+
+template<> struct bonesse<matrix3x4>
+{
+    __m128 ax, ay, az, aw, bx, by, bz, bw, cx, cy, cz, cw;
+
+    bonesse(const matrix3x4 &a, const matrix3x4 &b, const matrix3x4 &c, const matrix3x4 &d)
+    {
+        loadsse(&a.a.x, &b.a.x, &c.a.x, &d.a.x, ax, ay, az, aw);
+        loadsse(&a.b.x, &b.b.x, &c.b.x, &d.b.x, bx, by, bz, bw);
+        loadsse(&a.c.x, &b.c.x, &c.c.x, &d.c.x, cx, cy, cz, cw);
+    }
+
+    static inline __m128 dot3(__m128 mx, __m128 my, __m128 mz, __m128 x, __m128 y, __m128 z)
+    {
+        return _mm_add_ps(_mm_add_ps(_mm_mul_ps(mx, x), _mm_mul_ps(my, y)), _mm_mul_ps(mz, z));
+    }
+
+    void transform(__m128 &x, __m128 &y, __m128 &z) const
+    {
+        __m128 tx = _mm_add_ps(dot3(ax, ay, az, x, y, z), aw),
+               ty = _mm_add_ps(dot3(bx, by, bz, x, y, z), bw),
+               tz = _mm_add_ps(dot3(cx, cy, cz, x, y, z), cw);
+        x = tx; y = ty; z = tz;
+    }
+
+    void transformnormal(__m128 &x, __m128 &y, __m128 &z) const
+    {
+        __m128 tx = dot3(ax, ay, az, x, y, z),
+               ty = dot3(bx, by, bz, x, y, z),
+               tz = dot3(cx, cy, cz, x, y, z);
+        x = tx; y = ty; z = tz;
+    }
+};
+#endif
+
 struct skelmodel : animmodel
 {
     struct vert { vec pos, norm; float u, v; int blend, interpindex; };
@@ -148,9 +270,10 @@ struct skelmodel : animmodel
         dualquat *bdata;
         matrix3x4 *mdata;
         int version;
+        uint hash;
         bool dirty;
  
-        skelcacheentry() : bdata(NULL), mdata(NULL), version(-1), dirty(false) {}
+        skelcacheentry() : bdata(NULL), mdata(NULL), version(-1), hash(0), dirty(false) {}
         
         void nextversion()
         {
@@ -411,14 +534,52 @@ struct skelmodel : animmodel
             }
         }
 
+#ifdef __SSE__
+        template<class M>
+        int interpvertssse(const M * RESTRICT mdata1, const M * RESTRICT mdata2, int blendoffset, bool norms, bool tangents, uchar * RESTRICT vdata, int stride)
+        {
+            #define SSEVERTS(field) &(src[0].field).x, &(src[1].field).x, &(src[2].field).x, &(src[3].field).x
+            #define SSEDST(type, field) &((type *)vdata)->field.x, &((type *)(vdata + stride))->field.x, &((type *)(vdata + 2*stride))->field.x, &((type *)(vdata + 3*stride))->field.x
+            int i = 0;
+            for(; i + 4 <= numverts; i += 4, vdata += 4*stride)
+            {
+                const vert *src = &verts[i];
+                #define SSEBONE(k) (src[k].interpindex < blendoffset ? mdata1 : mdata2)[src[k].interpindex]
+                bonesse<M> m(SSEBONE(0), SSEBONE(1), SSEBONE(2), SSEBONE(3));
+                #undef SSEBONE
+                __m128 x, y, z, w;
+                loadsse(SSEVERTS(pos), x, y, z, w);
+                m.transform(x, y, z);
+                storesse(SSEDST(vvert, pos), x, y, z);
+                if(!norms && !tangents) continue;
+                loadsse(SSEVERTS(norm), x, y, z, w);
+                m.transformnormal(x, y, z);
+                storesse(SSEDST(vvertn, norm), x, y, z);
+                if(!tangents || !bumpverts) continue;
+                const bumpvert *bsrc = &bumpverts[i];
+                loadsse(&bsrc[0].tangent.x, &bsrc[1].tangent.x, &bsrc[2].tangent.x, &bsrc[3].tangent.x, x, y, z, w);
+                m.transformnormal(x, y, z);
+                storesse(SSEDST(vvertbump, tangent), x, y, z);
+            }
+            #undef SSEVERTS
+            #undef SSEDST
+            return i;
+        }
+#endif
+
         template<class M>
         void interpverts(const M * RESTRICT mdata1, const M * RESTRICT mdata2, bool norms, bool tangents, void * RESTRICT vdata, skin &s)
         {
             const int blendoffset = ((skelmeshgroup *)group)->skel->numgpubones;
             mdata2 -= blendoffset;
 
+#ifdef __SSE__
+            #define IPSTART(type) interpvertssse(mdata1, mdata2, blendoffset, norms, tangents, (uchar *)vdata, sizeof(type))
+#else
+            #define IPSTART(type) 0
+#endif
             #define IPLOOP(type, dosetup, dotransform) \
-                loopi(numverts) \
+                for(int i = IPSTART(type); i < numverts; i++) \
                 { \
                     const vert &src = verts[i]; \
                     type &dst = ((type * RESTRICT)vdata)[i]; \
@@ -444,6 +605,7 @@ struct skelmodel : animmodel
             else { IPLOOP(vvert, , ); }
 
             #undef IPLOOP
+            #undef IPSTART
         }
 
         void setshader(Shader *s)
@@ -607,6 +769,18 @@ struct skelmodel : animmodel
         pitchcorrect() : parent(-1), pitchangle(0), pitchtotal(0) {}
     };
 
+    struct skeleton;
+
+    struct skeljob
+    {
+        skeleton *skel;
+        int cache, numanimparts;
+        bool matskel;
+        vec axis, forward;
+    };
+
+    static vector<skeljob> skeljobs;
+
     struct skeleton
     {
         char *name;
@@ -625,9 +799,10 @@ struct skelmodel : animmodel
 
         bool usegpuskel, usematskel;
         vector<skelcacheentry> skelcache;
+        int skelcachetrim;
         hashtable<GLuint, int> blendoffsets;
 
-        skeleton() : name(NULL), shared(0), bones(NULL), numbones(0), numinterpbones(0), numgpubones(0), numframes(0), framebones(NULL), ragdoll(NULL), usegpuskel(false), usematskel(false), blendoffsets(32)
+        skeleton() : name(NULL), shared(0), bones(NULL), numbones(0), numinterpbones(0), numgpubones(0), numframes(0), framebones(NULL), ragdoll(NULL), usegpuskel(false), usematskel(false), skelcachetrim(-1), blendoffsets(32)
         {
         }
 
@@ -973,30 +1148,30 @@ struct skelmodel : animmodel
             return atan2f(dy, dx)/RAD;
         }
 
-        void calcpitchcorrects(float pitch, const vec &axis, const vec &forward)
+        void calcpitchcorrects(float pitch, const vec &axis, const vec &forward, vector<pitchdep> &deps, vector<pitchtarget> &targets, vector<pitchcorrect> &corrects)
         {
-            loopv(pitchtargets)
+            loopv(targets)
             {
-                pitchtarget &t = pitchtargets[i];
-                t.deviated = calcdeviation(axis, forward, t.pose, pitchdeps[t.deps].pose);
+                pitchtarget &t = targets[i];
+                t.deviated = calcdeviation(axis, forward, t.pose, deps[t.deps].pose);
             }
-            loopv(pitchcorrects)
+            loopv(corrects)
             {
-                pitchcorrect &c = pitchcorrects[i];
+                pitchcorrect &c = corrects[i];
                 c.pitchangle = c.pitchtotal = 0;
             }
-            loopvj(pitchtargets)
+            loopvj(targets)
             {
-                pitchtarget &t = pitchtargets[j];
+                pitchtarget &t = targets[j];
                 float tpitch = pitch - t.deviated;
-                for(int parent = t.corrects; parent >= 0; parent = pitchcorrects[parent].parent)
-                    tpitch -= pitchcorrects[parent].pitchangle;
+                for(int parent = t.corrects; parent >= 0; parent = corrects[parent].parent)
+                    tpitch -= corrects[parent].pitchangle;
                 if(t.pitchmin || t.pitchmax) tpitch = clamp(tpitch, t.pitchmin, t.pitchmax);
-                loopv(pitchcorrects)
+                loopv(corrects)
                 {
-                    pitchcorrect &c = pitchcorrects[i];
+                    pitchcorrect &c = corrects[i];
                     if(c.target != j) continue;
-                    float total = c.parent >= 0 ? pitchcorrects[c.parent].pitchtotal : 0, 
+                    float total = c.parent >= 0 ? corrects[c.parent].pitchtotal : 0, 
                           avail = tpitch - total, 
                           used = tpitch*c.pitchscale;
                     if(c.pitchmin || c.pitchmax)
@@ -1025,7 +1200,6 @@ struct skelmodel : animmodel
             }
 
         #define INTERPBONES(outbody, rotbody) \
-            sc.nextversion(); \
             struct framedata \
             { \
                 const dualquat *fr1, *fr2, *pfr1, *pfr2; \
@@ -1040,15 +1214,15 @@ struct skelmodel : animmodel
                     partframes[i].pfr2 = &framebones[as[i].prev.fr2*numbones]; \
                 } \
             } \
-            loopv(pitchdeps) \
+            loopv(deps) \
             { \
-                pitchdep &p = pitchdeps[i]; \
+                pitchdep &p = deps[i]; \
                 INTERPBONE(p.bone); \
                 d.normalize(); \
-                if(p.parent >= 0) p.pose.mul(pitchdeps[p.parent].pose, d); \
+                if(p.parent >= 0) p.pose.mul(deps[p.parent].pose, d); \
                 else p.pose = d; \
             } \
-            calcpitchcorrects(pitch, axis, forward); \
+            calcpitchcorrects(pitch, axis, forward, deps, targets, corrects); \
             loopi(numbones) if(bones[i].interpindex>=0) \
             { \
                 INTERPBONE(i); \
@@ -1056,17 +1230,22 @@ struct skelmodel : animmodel
                 outbody; \
                 float angle; \
                 if(b.pitchscale) { angle = b.pitchscale*pitch + b.pitchoffset; if(b.pitchmin || b.pitchmax) angle = clamp(angle, b.pitchmin, b.pitchmax); } \
-                else if(b.correctindex >= 0) angle = pitchcorrects[b.correctindex].pitchangle; \
+                else if(b.correctindex >= 0) angle = corrects[b.correctindex].pitchangle; \
                 else continue; \
                 if(as->cur.anim&ANIM_NOPITCH || (as->interp < 1 && as->prev.anim&ANIM_NOPITCH)) \
                     angle *= (as->cur.anim&ANIM_NOPITCH ? 0 : as->interp) + (as->interp < 1 && as->prev.anim&ANIM_NOPITCH ? 0 : 1-as->interp); \
                 rotbody; \
             }
 
-        void interpmatbones(const animstate *as, float pitch, const vec &axis, const vec &forward, int numanimparts, const uchar *partmask, skelcacheentry &sc)
+        void prepbones(skelcacheentry &sc)
+        {
+            if(matskel) { if(!sc.mdata) sc.mdata = new matrix3x4[numinterpbones]; if(lastsdata == sc.mdata) lastsdata = NULL; }
+            else { if(!sc.bdata) sc.bdata = new dualquat[numinterpbones]; if(lastsdata == sc.bdata) lastsdata = NULL; }
+            sc.nextversion();
+        }
+
+        void interpmatbones(const animstate *as, float pitch, const vec &axis, const vec &forward, int numanimparts, const uchar *partmask, skelcacheentry &sc, vector<pitchdep> &deps, vector<pitchtarget> &targets, vector<pitchcorrect> &corrects)
         {
-            if(!sc.mdata) sc.mdata = new matrix3x4[numinterpbones];
-            if(lastsdata == sc.mdata) lastsdata = NULL;
             INTERPBONES(
             {
                 matrix3x4 m(d);
@@ -1078,10 +1257,8 @@ struct skelmodel : animmodel
             });
         }
 
-        void interpbones(const animstate *as, float pitch, const vec &axis, const vec &forward, int numanimparts, const uchar *partmask, skelcacheentry &sc)
+        void interpbones(const animstate *as, float pitch, const vec &axis, const vec &forward, int numanimparts, const uchar *partmask, skelcacheentry &sc, vector<pitchdep> &deps, vector<pitchtarget> &targets, vector<pitchcorrect> &corrects)
         {
-            if(!sc.bdata) sc.bdata = new dualquat[numinterpbones];
-            if(lastsdata == sc.bdata) lastsdata = NULL;
             INTERPBONES(
             {
                 d.normalize();
@@ -1249,6 +1426,54 @@ struct skelmodel : animmodel
             }
         }
 
+        static inline uint hashfloat(float f)
+        {
+            union { float f; uint u; } conv;
+            conv.f = f + 0.0f; // folds -0 into 0
+            return conv.u;
+        }
+
+        static inline uint hashpos(uint h, const animpos &p)
+        {
+            h = (h<<5) + h + p.fr1;
+            h = (h<<5) + h + p.fr2;
+            return p.fr1!=p.fr2 ? (h<<5) + h + hashfloat(p.t) : h;
+        }
+
+        // only hashes what animstate::operator== looks at, so equal poses always land on equal hashes
+        static uint hashpose(const animstate *as, int numanimparts, float pitch, const uchar *partmask, const ragdolldata *rdata)
+        {
+            uint h = hashfloat(pitch) ^ uint(size_t(partmask)) ^ uint(size_t(rdata));
+            loopi(numanimparts)
+            {
+                const animstate &a = as[i];
+                h = hashpos(h, a.cur);
+                if(a.interp<1) h = hashpos((h<<5) + h + hashfloat(a.interp), a.prev);
+            }
+            return h;
+        }
+
+        static inline float quantizeanim(float t)
+        {
+            return floorf(t*skelquant + 0.5f)/skelquant;
+        }
+
+        /// evicts the least recently used poses down to maxskelcache; only safe between frames,
+        /// as the entries handed out during a frame are referenced by index until it is drawn
+        void trimskelcache()
+        {
+            while(skelcache.length() > maxskelcache)
+            {
+                int oldest = 0;
+                loopv(skelcache) if(skelcache[i].millis < skelcache[oldest].millis) oldest = i;
+                skelcacheentry &c = skelcache[oldest];
+                if(lastsdata == c.bdata || lastsdata == c.mdata) lastsdata = NULL;
+                DELETEA(c.bdata);
+                DELETEA(c.mdata);
+                skelcache.remove(oldest);
+            }
+        }
+
         skelcacheentry &checkskelcache(part *p, const animstate *as, float pitch, const vec &axis, const vec &forward, ragdolldata *rdata)
         {
             if(skelcache.empty()) 
@@ -1256,41 +1481,101 @@ struct skelmodel : animmodel
                 usegpuskel = gpuaccelerate();
                 usematskel = matskel!=0;
             }
+            // the first lookup of a frame comes before any entry of it is in use
+            if(skelcachetrim != totalmillis)
+            {
+                trimskelcache();
+                skelcachetrim = totalmillis;
+            }
 
             int numanimparts = ((skelpart *)as->owner)->numanimparts;
             uchar *partmask = ((skelpart *)as->owner)->partmask;
+            animstate qas[MAXANIMPARTS];
+            if(skelquant && !rdata)
+            {
+                loopi(numanimparts)
+                {
+                    qas[i] = as[i];
+                    qas[i].cur.t = quantizeanim(as[i].cur.t);
+                    if(as[i].interp<1)
+                    {
+                        qas[i].prev.t = quantizeanim(as[i].prev.t);
+                        qas[i].interp = min(quantizeanim(as[i].interp), 0.999f);
+                    }
+                }
+                as = qas;
+            }
+            uint hash = hashpose(as, numanimparts, pitch, partmask, rdata);
             skelcacheentry *sc = NULL;
             bool match = false;
             loopv(skelcache)
             {
                 skelcacheentry &c = skelcache[i];
+                if(c.hash != hash) goto mismatch;
                 loopj(numanimparts) if(c.as[j]!=as[j]) goto mismatch;
                 if(c.pitch != pitch || c.partmask != partmask || c.ragdoll != rdata || (rdata && c.millis < rdata->lastmove)) goto mismatch;
                 match = true;
                 sc = &c;
                 break;
             mismatch:
-                if(c.millis < lastmillis) { sc = &c; break; }
+                // evict whichever pose has gone unused the longest, without cutting the search short
+                if(c.millis < lastmillis && (!sc || c.millis < sc->millis)) sc = &c;
             }
             if(!sc) sc = &skelcache.add();
-            if(!match)
+            if(match) skelcachehits++;
+            else
             {
+                skelcachemisses++;
                 loopi(numanimparts) sc->as[i] = as[i];
                 sc->pitch = pitch;
                 sc->partmask = partmask;
                 sc->ragdoll = rdata;
+                sc->hash = hash;
                 if(rdata)
                 {
                     if(matskel) genmatragdollbones(*rdata, *sc, p);
                     else genragdollbones(*rdata, *sc, p);
                 }
-                else if(matskel) interpmatbones(as, pitch, axis, forward, numanimparts, partmask, *sc);
-                else interpbones(as, pitch, axis, forward, numanimparts, partmask, *sc);
+                else
+                {
+                    prepbones(*sc);
+                    if(prepass) deferbones(*sc, numanimparts, axis, forward);
+                    else if(matskel) interpmatbones(as, pitch, axis, forward, numanimparts, partmask, *sc, pitchdeps, pitchtargets, pitchcorrects);
+                    else interpbones(as, pitch, axis, forward, numanimparts, partmask, *sc, pitchdeps, pitchtargets, pitchcorrects);
+                }
             }
             sc->millis = lastmillis;
             return *sc;
         }
 
+        void deferbones(skelcacheentry &sc, int numanimparts, const vec &axis, const vec &forward)
+        {
+            skeljob &j = skeljobs.add();
+            j.skel = this;
+            j.cache = &sc - skelcache.getbuf();
+            j.numanimparts = numanimparts;
+            j.matskel = matskel!=0;
+            j.axis = axis;
+            j.forward = forward;
+        }
+
+        void runjob(const skeljob &j)
+        {
+            skelcacheentry &sc = skelcache[j.cache];
+            if(pitchdeps.empty() && pitchcorrects.empty())
+            {
+                if(j.matskel) interpmatbones(sc.as, sc.pitch, j.axis, j.forward, j.numanimparts, sc.partmask, sc, pitchdeps, pitchtargets, pitchcorrects);
+                else interpbones(sc.as, sc.pitch, j.axis, j.forward, j.numanimparts, sc.partmask, sc, pitchdeps, pitchtargets, pitchcorrects);
+                return;
+            }
+            // the pitch correction scratch is shared by all users of the skeleton, so each job works on its own copy
+            vector<pitchdep> deps(pitchdeps);
+            vector<pitchtarget> targets(pitchtargets);
+            vector<pitchcorrect> corrects(pitchcorrects);
+            if(j.matskel) interpmatbones(sc.as, sc.pitch, j.axis, j.forward, j.numanimparts, sc.partmask, sc, deps, targets, corrects);
+            else interpbones(sc.as, sc.pitch, j.axis, j.forward, j.numanimparts, sc.partmask, sc, deps, targets, corrects);
+        }
+
         void setasmbones(skelcacheentry &sc, int count = 0)
         {
             if(sc.dirty) sc.dirty = false;
@@ -1817,6 +2102,7 @@ struct skelmodel : animmodel
             }
 
             skelcacheentry &sc = skel->checkskelcache(p, as, pitch, axis, forward, as->cur.anim&ANIM_RAGDOLL || !d || !d->ragdoll || d->ragdoll->skel != skel->ragdoll ? NULL : d->ragdoll);
+            if(prepass) return;
             if(!(as->cur.anim&ANIM_NORENDER))
             {
                 int owner = &sc-&skel->skelcache[0];
@@ -1959,8 +2245,23 @@ struct skelmodel : animmodel
     }
     
     bool skeletal() const { return true; }
+
+    static void runskeljob(void *data, int i, int thread)
+    {
+        const skeljob &j = ((skeljob *)data)[i];
+        j.skel->runjob(j);
+    }
+
+    // evaluates the skeletons queued up by a prepass across the job threads
+    static void flushskeljobs()
+    {
+        runjobs(runskeljob, skeljobs.getbuf(), skeljobs.length());
+        skeljobs.setsize(0);
+    }
 };
 
+vector<skelmodel::skeljob> skelmodel::skeljobs;
+
 struct skeladjustment
 {
     float yaw, pitch, roll;
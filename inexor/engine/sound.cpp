@@ -7,15 +7,35 @@
 
 bool nosound = true;
 
+static size_t samplebytes = 0;
+
 struct soundsample
 {
     char *name;
     Mix_Chunk *chunk;
+    int request, ext, lastused; // request is the id of the pending asynchronous load, 0 if none
 
-    soundsample() : name(NULL), chunk(NULL) {}
+    soundsample() : name(NULL), chunk(NULL), request(0), ext(0), lastused(0) {}
     ~soundsample() { DELETEA(name); }
 
-    void cleanup() { if(chunk) { Mix_FreeChunk(chunk); chunk = NULL; } }
+    void setchunk(Mix_Chunk *c)
+    {
+        cleanup();
+        chunk = c;
+        if(chunk) samplebytes += chunk->alen;
+        lastused = totalmillis;
+    }
+
+    void cleanup()
+    {
+        if(chunk) 
+        { 
+            samplebytes -= chunk->alen;
+            Mix_FreeChunk(chunk); 
+            chunk = NULL; 
+        }
+        request = 0;
+    }
 };
 
 struct soundslot
@@ -307,11 +327,14 @@ void resetchannels()
     channels.shrink(0);
 }
 
+static void cleanupsounddecodes();
+
 void clear_sound()
 {
     closemumble();
     if(nosound) return;
     stopmusic();
+    cleanupsounddecodes();
     enumerate(samples, soundsample, s, s.cleanup());
     Mix_CloseAudio();
     resetchannels();
@@ -423,10 +446,13 @@ void syncchannels()
         }
 }
 
+static void checksounddecodes();
+
 void updatesounds()
 {
     updatemumble();
     if(nosound) return;
+    checksounddecodes();
     if(minimized) stopsounds();
     else 
     {
@@ -464,31 +490,258 @@ static Mix_Chunk *loadwav(const char *name)
     return c;
 }
 
+static const char * const soundexts[] = { "", ".wav", ".ogg" };
+
 static bool loadsoundslot(soundslot &slot, bool msg = false)
 {
     if(slot.sample->chunk) return true;
     if(!slot.sample->name[0]) return false;
 
-    static const char * const exts[] = { "", ".wav", ".ogg" };
     string filename;
-    loopi(sizeof(exts)/sizeof(exts[0]))
+    loopi(sizeof(soundexts)/sizeof(soundexts[0]))
     {
-        formatstring(filename)("%s/%s%s", sounddir, slot.sample->name, exts[i]);
+        formatstring(filename)("%s/%s%s", sounddir, slot.sample->name, soundexts[i]);
         if(msg && !i) renderprogress(0, filename);
         path(filename);
-        slot.sample->chunk = loadwav(filename);
-        if(slot.sample->chunk) return true;
+        Mix_Chunk *c = loadwav(filename);
+        if(c) { slot.sample->setchunk(c); return true; }
     }
 
     conoutf(CON_WARN, "failed to load sample: %s/%s", sounddir, slot.sample->name);
     return false;
 }
 
+// preloaded samples are read by the io threads and decoded on a thread of their own while the map loads,
+// which waits for them once the rest of the map is done; a sound played before its sample is ready waits for it
+VARP(asyncsounds, 0, 1, 1);
+VARP(soundcachesize, 0, 64, 1024); // megabytes of decoded samples kept before unused ones are evicted, 0 for no limit
+
+struct sounddecode
+{
+    char *name;
+    int request;
+    uchar *data;
+    size_t len;
+    Mix_Chunk *chunk;
+
+    sounddecode(const char *name, int request, uchar *data, size_t len) : name(newstring(name)), request(request), data(data), len(len), chunk(NULL) {}
+    ~sounddecode()
+    {
+        DELETEA(name);
+        DELETEA(data);
+        if(chunk) Mix_FreeChunk(chunk);
+    }
+};
+
+static SDL_Thread *decodethread = NULL;
+static SDL_mutex *decodelock = NULL;
+static SDL_cond *decodecond = NULL;
+static vector<sounddecode *> decodequeue, decodesdone;
+static bool decodeexit = false, decodebusy = false;
+
+static int sounddecoder(void *data)
+{
+    SDL_LockMutex(decodelock);
+    for(;;)
+    {
+        while(!decodeexit && decodequeue.empty()) SDL_CondWait(decodecond, decodelock);
+        if(decodeexit) break;
+        sounddecode *d = decodequeue.remove(0);
+        decodebusy = true;
+        SDL_UnlockMutex(decodelock);
+
+        SDL_RWops *rw = SDL_RWFromConstMem(d->data, int(d->len));
+        if(rw) d->chunk = Mix_LoadWAV_RW(rw, 1);
+        DELETEA(d->data);
+
+        SDL_LockMutex(decodelock);
+        decodebusy = false;
+        decodesdone.add(d);
+        SDL_CondBroadcast(decodecond);
+    }
+    SDL_UnlockMutex(decodelock);
+    return 0;
+}
+
+static bool queuesounddecode(sounddecode *d)
+{
+    if(!decodelock) decodelock = SDL_CreateMutex();
+    if(!decodecond) decodecond = SDL_CreateCond();
+    if(!decodelock || !decodecond) return false;
+    if(!decodethread)
+    {
+        decodeexit = false;
+        decodethread = SDL_CreateThread(sounddecoder, "sound decoder", NULL);
+        if(!decodethread) return false;
+    }
+    SDL_LockMutex(decodelock);
+    decodequeue.add(d);
+    SDL_CondBroadcast(decodecond);
+    SDL_UnlockMutex(decodelock);
+    return true;
+}
+
+static void waitsounddecodes()
+{
+    if(!decodelock) return;
+    SDL_LockMutex(decodelock);
+    while(decodequeue.length() || decodebusy) SDL_CondWait(decodecond, decodelock);
+    SDL_UnlockMutex(decodelock);
+}
+
+// drops queued decodes and waits for the one in progress, so the mixer can be closed safely
+static void flushsounddecodes()
+{
+    if(!decodelock) return;
+    SDL_LockMutex(decodelock);
+    decodequeue.deletecontents();
+    while(decodebusy) SDL_CondWait(decodecond, decodelock);
+    decodesdone.deletecontents();
+    SDL_UnlockMutex(decodelock);
+}
+
+static void cleanupsounddecodes()
+{
+    if(!decodethread) return;
+    flushsounddecodes();
+    SDL_LockMutex(decodelock);
+    decodeexit = true;
+    SDL_CondBroadcast(decodecond);
+    SDL_UnlockMutex(decodelock);
+    SDL_WaitThread(decodethread, NULL);
+    decodethread = NULL;
+}
+
+static void samplefileloaded(int id, const char *filename, bool ok, uchar *&data, size_t len, void *arg);
+
+static void requestsamplefile(soundsample &s)
+{
+    defformatstring(filename)("%s/%s%s", sounddir, s.name, soundexts[s.ext]);
+    path(filename);
+    // the sample name rides along instead of the sample itself, which may be gone by the time the file is read
+    s.request = asyncreadfile(filename, samplefileloaded, newstring(s.name));
+}
+
+static void nextsamplefile(soundsample &s)
+{
+    if(++s.ext < int(sizeof(soundexts)/sizeof(soundexts[0]))) requestsamplefile(s);
+    else
+    {
+        conoutf(CON_WARN, "failed to load sample: %s/%s", sounddir, s.name);
+        s.request = 0;
+    }
+}
+
+static void samplefileloaded(int id, const char *filename, bool ok, uchar *&data, size_t len, void *arg)
+{
+    char *name = (char *)arg;
+    soundsample *s = samples.access(name);
+    if(s && s->request == id)
+    {
+        if(!ok || !len) nextsamplefile(*s);
+        else
+        {
+            sounddecode *d = new sounddecode(name, id, data, len);
+            data = NULL;
+            if(!queuesounddecode(d))
+            {
+                data = d->data;
+                d->data = NULL;
+                delete d;
+                s->request = 0;
+            }
+        }
+    }
+    delete[] name;
+}
+
+static void requestsample(soundsample &s)
+{
+    if(s.chunk || s.request || !s.name[0]) return;
+    s.ext = 0;
+    requestsamplefile(s);
+}
+
+static bool issampleplaying(const soundsample *s)
+{
+    loopv(channels) if(channels[i].inuse && channels[i].slot->sample == s) return true;
+    return false;
+}
+
+static void evictsamples(const soundsample *keep)
+{
+    if(!soundcachesize) return;
+    size_t limit = size_t(soundcachesize)<<20;
+    while(samplebytes > limit)
+    {
+        soundsample *oldest = NULL;
+        enumerate(samples, soundsample, s,
+        {
+            if(s.chunk && &s != keep && (!oldest || s.lastused < oldest->lastused) && !issampleplaying(&s)) oldest = &s;
+        });
+        if(!oldest) break;
+        oldest->cleanup();
+    }
+}
+
+static void checksounddecodes()
+{
+    if(!decodelock) return;
+    static vector<sounddecode *> done;
+    SDL_LockMutex(decodelock);
+    done.move(decodesdone);
+    SDL_UnlockMutex(decodelock);
+    loopv(done)
+    {
+        sounddecode *d = done[i];
+        soundsample *s = samples.access(d->name);
+        if(s && s->request == d->request && !s->chunk)
+        {
+            if(d->chunk)
+            {
+                s->setchunk(d->chunk);
+                d->chunk = NULL;
+                evictsamples(s);
+            }
+            else nextsamplefile(*s);
+        }
+        delete d;
+    }
+    done.setsize(0);
+}
+
+// blocks until the pending load of the sample has either produced a chunk or failed
+static void finishsample(soundsample &s)
+{
+    while(s.request && !s.chunk)
+    {
+        int request = s.request;
+        // once its file is read the request waits on the decoder under the same id
+        if(!waitasyncfile(request))
+        {
+            waitsounddecodes();
+            checksounddecodes();
+            if(s.request == request && !s.chunk) s.request = 0;
+        }
+    }
+}
+
+void flushpreloadedsounds()
+{
+    if(nosound) return;
+    enumerate(samples, soundsample, s, finishsample(s));
+}
+
 static inline void preloadsound(vector<soundconfig> &sounds, vector<soundslot> &slots, int n)
 {
     if(nosound || !sounds.inrange(n)) return;
     soundconfig &config = sounds[n];
-    loopk(config.numslots) loadsoundslot(slots[config.slots+k], true);
+    loopk(config.numslots) 
+    {
+        soundslot &slot = slots[config.slots+k];
+        if(asyncsounds) requestsample(*slot.sample);
+        else loadsoundslot(slot, true);
+    }
 }
 
 void preloadsound(int n)
@@ -563,7 +816,14 @@ int playsound(int n, const vec *loc, extentity *ent, int flags, int loops, int f
     if(fade < 0) return -1;
 
     soundslot &slot = slots[config.chooseslot()];
-    if(!slot.sample->chunk && !loadsoundslot(slot)) return -1;
+    if(!slot.sample->chunk)
+    {
+        if(slot.sample->request) finishsample(*slot.sample);
+        else loadsoundslot(slot);
+        if(!slot.sample->chunk) return -1;
+        evictsamples(slot.sample);
+    }
+    slot.sample->lastused = totalmillis;
 
     if(dbgsound) conoutf("sound: %s", slot.sample->name);
  
@@ -624,6 +884,7 @@ void resetsound()
     clearchanges(CHANGE_SOUND);
     if(!nosound) 
     {
+        flushsounddecodes();
         enumerate(samples, soundsample, s, s.cleanup());
         if(music)
         {
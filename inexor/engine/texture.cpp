@@ -1107,6 +1107,33 @@ SDL_Surface *loadsurface(const char *name)
     if(!s) s = IMG_Load(findfile(name, "rb"));
     return fixsurfaceformat(s);
 }
+
+// an image file read ahead of time, so it can be decoded off the main thread
+struct texfile
+{
+    char *name;
+    uchar *data;
+    size_t len;
+    int id;
+    bool done;
+};
+
+static SDL_Surface *loadsurface(const char *name, const vector<texfile> &files)
+{
+    loopv(files) if(!strcmp(files[i].name, name))
+    {
+        const texfile &f = files[i];
+        if(!f.data || !f.len) return NULL;
+        SDL_RWops *rw = SDL_RWFromConstMem(f.data, int(f.len));
+        if(!rw) return NULL;
+        const char *ext = strrchr(name, '.');
+        if(ext) ++ext;
+        SDL_Surface *s = IMG_LoadTyped_RW(rw, 0, ext);
+        SDL_FreeRW(rw);
+        return fixsurfaceformat(s);
+    }
+    return NULL;
+}
    
 static vec parsevec(const char *arg)
 {
@@ -1125,7 +1152,7 @@ VAR(usedds, 0, 1, 1);
 VAR(dbgdds, 0, 0, 1);
 VAR(scaledds, 0, 2, 4);
 
-static bool texturedata(ImageData &d, const char *tname, Slot::Tex *tex = NULL, bool msg = true, int *compress = NULL)
+static bool texturedata(ImageData &d, const char *tname, Slot::Tex *tex = NULL, bool msg = true, int *compress = NULL, const vector<texfile> *files = NULL)
 {
     const char *cmds = NULL, *file = tname;
 
@@ -1141,7 +1168,7 @@ static bool texturedata(ImageData &d, const char *tname, Slot::Tex *tex = NULL,
         }
         else file = tex->name;
         
-        static string pname;
+        string pname;
         formatstring(pname)("%s", file);
         file = path(pname);
     }
@@ -1205,11 +1232,11 @@ static bool texturedata(ImageData &d, const char *tname, Slot::Tex *tex = NULL,
         
     if(!d.data)
     {
-        SDL_Surface *s = loadsurface(file);
+        SDL_Surface *s = files ? loadsurface(file, *files) : loadsurface(file);
         if(!s) { if(msg) conoutf(CON_WARN, "could not load texture %s", file); return false; }
         int bpp = s->format->BitsPerPixel;
-        if(bpp%8 || !texformat(bpp/8)) { SDL_FreeSurface(s); conoutf(CON_WARN, "texture must be 8, 16, 24, or 32 bpp: %s", file); return false; }
-        if(max(s->w, s->h) > (1<<12)) { SDL_FreeSurface(s); conoutf(CON_WARN, "texture size exceeded %dx%d pixels: %s", 1<<12, 1<<12, file); return false; }
+        if(bpp%8 || !texformat(bpp/8)) { SDL_FreeSurface(s); if(msg) conoutf(CON_WARN, "texture must be 8, 16, 24, or 32 bpp: %s", file); return false; }
+        if(max(s->w, s->h) > (1<<12)) { SDL_FreeSurface(s); if(msg) conoutf(CON_WARN, "texture size exceeded %dx%d pixels: %s", 1<<12, 1<<12, file); return false; }
         d.wrap(s);
     }
 
@@ -1942,13 +1969,14 @@ static void addname(vector<char> &key, Slot &slot, Slot::Tex &t, bool combined =
     for(const char *s = path(t.name); *s; key.add(*s++));
 }
 
-static void texcombine(Slot &s, int index, Slot::Tex &t, bool forceload = false)
+// works out which of the slot's textures get combined into t and the name of the result;
+// returns false if t was already resolved to an existing texture
+static bool texcombinekey(Slot &s, int index, Slot::Tex &t, bool forceload, vector<char> &key, int &texmask, bool &envmap)
 {
-    if(renderpath==R_FIXEDFUNCTION && t.type!=TEX_DIFFUSE && t.type!=TEX_GLOW && !forceload) { t.t = notexture; return; }
-    vector<char> key; 
+    if(renderpath==R_FIXEDFUNCTION && t.type!=TEX_DIFFUSE && t.type!=TEX_GLOW && !forceload) { t.t = notexture; return false; }
     addname(key, s, t);
-    int texmask = 0;
-    bool envmap = renderpath==R_FIXEDFUNCTION && s.shader->type&SHADER_ENVMAP && s.ffenv && hasCM && maxtmus >= 2;
+    texmask = 0;
+    envmap = renderpath==R_FIXEDFUNCTION && s.shader->type&SHADER_ENVMAP && s.ffenv && hasCM && maxtmus >= 2;
     if(!forceload) switch(t.type)
     {
         case TEX_DIFFUSE:
@@ -1978,10 +2006,15 @@ static void texcombine(Slot &s, int index, Slot::Tex &t, bool forceload = false)
     }
     key.add('\0');
     t.t = textures.access(key.getbuf());
-    if(t.t) return;
-    int compress = 0;
-    ImageData ts;
-    if(!texturedata(ts, NULL, &t, true, &compress)) { t.t = notexture; return; }
+    return !t.t;
+}
+
+// loads t and merges the textures combined into it, only touching the slot to read it;
+// with files given the images come from those and nothing is reported
+static bool texcombinedata(Slot &s, int index, Slot::Tex &t, ImageData &ts, int &compress, int texmask, bool envmap, const vector<texfile> *files = NULL)
+{
+    bool msg = !files;
+    if(!texturedata(ts, NULL, &t, msg, &compress, files)) return false;
     switch(t.type)
     {
         case TEX_DIFFUSE:
@@ -1992,7 +2025,7 @@ static void texcombine(Slot &s, int index, Slot::Tex &t, bool forceload = false)
                     Slot::Tex &b = s.sts[i];
                     if(b.combined!=index) continue;
                     ImageData bs;
-                    if(!texturedata(bs, NULL, &b)) continue;
+                    if(!texturedata(bs, NULL, &b, msg, NULL, files)) continue;
                     if(bs.w!=ts.w || bs.h!=ts.h) scaleimage(bs, ts.w, ts.h);
                     switch(b.type)
                     {
@@ -2010,7 +2043,7 @@ static void texcombine(Slot &s, int index, Slot::Tex &t, bool forceload = false)
                 Slot::Tex &a = s.sts[i];
                 if(a.combined!=index) continue;
                 ImageData as;
-                if(!texturedata(as, NULL, &a)) continue;
+                if(!texturedata(as, NULL, &a, msg, NULL, files)) continue;
                 //if(ts.bpp!=4) forcergbaimage(ts);
                 if(as.w!=ts.w || as.h!=ts.h) scaleimage(as, ts.w, ts.h);
                 switch(a.type)
@@ -2022,6 +2055,18 @@ static void texcombine(Slot &s, int index, Slot::Tex &t, bool forceload = false)
             }
             break;
     }
+    return true;
+}
+
+static void texcombine(Slot &s, int index, Slot::Tex &t, bool forceload = false)
+{
+    vector<char> key;
+    int texmask = 0;
+    bool envmap = false;
+    if(!texcombinekey(s, index, t, forceload, key, texmask, envmap)) return;
+    int compress = 0;
+    ImageData ts;
+    if(!texcombinedata(s, index, t, ts, compress, texmask, envmap)) { t.t = notexture; return; }
     t.t = newtexture(NULL, key.getbuf(), ts, 0, true, true, true, compress);
 }
 
@@ -2047,6 +2092,477 @@ static Slot &loadslot(Slot &s, bool forceload)
     return s;
 }
 
+// slot textures are preloaded in three overlapping stages: the io threads read the image files,
+// the job threads decode and combine them, and the main thread only creates the GL textures
+
+VARP(texloadbatch, 1, 8, 256);
+
+struct texload
+{
+    Slot *slot;
+    int index, texmask, compress;
+    bool envmap, ok, cached;
+    char *key;
+    vector<texfile> files;
+    texfile cache;
+    ImageData image;
+
+    texload() : slot(NULL), index(-1), texmask(0), compress(0), envmap(false), ok(false), cached(false), key(NULL)
+    {
+        cache.name = NULL;
+        cache.data = NULL;
+        cache.len = 0;
+        cache.id = -1;
+        cache.done = true;
+    }
+    ~texload()
+    {
+        DELETEA(key);
+        loopv(files)
+        {
+            DELETEA(files[i].name);
+            DELETEA(files[i].data);
+        }
+        DELETEA(cache.name);
+        DELETEA(cache.data);
+    }
+};
+
+// processed slot textures are kept on disk, named by hashes of their key, the settings that
+// shape them and the contents of their source files; the index tracks when each was last used
+// so the oldest can be evicted once the cache outgrows texcachesize megabytes
+
+VARP(texcache, 0, 1, 1);
+VARP(texcachesize, 0, 256, 4096);
+
+#define TEXCACHEDIR "cache/textures/"
+#define TEXCACHEVERSION 1
+
+struct texcacheheader
+{
+    char magic[4];
+    int version, keylen, w, h, bpp, levels, align, compressed, compress;
+};
+
+struct texcacheentry
+{
+    char *name;
+    int size;
+    uint lastused;
+
+    texcacheentry() : name(NULL), size(0), lastused(0) {}
+    ~texcacheentry() { DELETEA(name); }
+};
+
+static inline bool htcmp(const char *key, const texcacheentry &e) { return !strcmp(key, e.name); }
+
+static hashset<texcacheentry> texcacheentries;
+static uint texcachestamp = 0;
+static bool texcacheloaded = false, texcachedirty = false;
+
+static texcacheentry &addtexcacheentry(const char *name)
+{
+    texcacheentry &e = texcacheentries[name];
+    if(!e.name) e.name = newstring(name);
+    return e;
+}
+
+static void loadtexcacheindex()
+{
+    if(texcacheloaded) return;
+    texcacheloaded = true;
+    char *buf = loadfile(TEXCACHEDIR "index.txt", NULL);
+    if(!buf) return;
+    for(char *line = buf; *line;)
+    {
+        char *end = line + strcspn(line, "\n");
+        string name;
+        int size = 0;
+        uint lastused = 0;
+        if(sscanf(line, "%259s %d %u", name, &size, &lastused) == 3)
+        {
+            texcacheentry &e = addtexcacheentry(name);
+            e.size = size;
+            e.lastused = lastused;
+            texcachestamp = max(texcachestamp, lastused);
+        }
+        line = *end ? end+1 : end;
+    }
+    delete[] buf;
+}
+
+static void savetexcacheindex()
+{
+    if(!texcachedirty) return;
+    texcachedirty = false;
+    vector<char> buf;
+    enumerate(texcacheentries, texcacheentry, e,
+    {
+        defformatstring(line)("%s %d %u\n", e.name, e.size, e.lastused);
+        buf.put(line, strlen(line));
+    });
+    uchar *data = new uchar[max(buf.length(), 1)];
+    memcpy(data, buf.getbuf(), buf.length());
+    asyncwritefile(TEXCACHEDIR "index.txt", data, buf.length());
+}
+
+static bool comparetexcacheentries(texcacheentry *x, texcacheentry *y)
+{
+    return x->lastused < y->lastused;
+}
+
+static void evicttexcache()
+{
+    vector<texcacheentry *> entries;
+    size_t total = 0, limit = size_t(texcachesize)<<20;
+    enumerate(texcacheentries, texcacheentry, e, { entries.add(&e); total += e.size; });
+    if(total <= limit) return;
+    entries.sort(comparetexcacheentries);
+    loopv(entries)
+    {
+        if(total <= limit || entries[i]->lastused >= texcachestamp) break;
+        string name;
+        copystring(name, entries[i]->name);
+        total -= entries[i]->size;
+        defformatstring(file)(TEXCACHEDIR "%s", name);
+        remove(findfile(file, "w"));
+        texcacheentries.remove(name);
+        texcachedirty = true;
+    }
+}
+
+static inline const char *texcachename(const texload &l) { return l.cache.name + strlen(TEXCACHEDIR); }
+
+static void hashtexload(void *data, int i, int thread)
+{
+    texload &l = *((texload **)data)[i];
+    uint keyhash = crc32(0, NULL, 0), datahash = keyhash;
+    int settings[] = { TEXCACHEVERSION, renderpath, usetexcompress, texcompress };
+    keyhash = crc32(keyhash, (const Bytef *)l.key, strlen(l.key));
+    keyhash = crc32(keyhash, (const Bytef *)settings, sizeof(settings));
+    loopvj(l.files)
+    {
+        const texfile &f = l.files[j];
+        if(!f.data) return;
+        datahash = crc32(datahash, (const Bytef *)f.name, strlen(f.name));
+        datahash = crc32(datahash, f.data, f.len);
+    }
+    defformatstring(name)(TEXCACHEDIR "%08x%08x.tex", keyhash, datahash);
+    l.cache.name = newstring(name);
+}
+
+static void texfileloaded(int id, const char *name, bool ok, uchar *&data, size_t len, void *arg);
+
+static void requesttexcache(texload &l)
+{
+    if(!l.cache.name) return;
+    texcacheentry *e = texcacheentries.access(texcachename(l));
+    if(!e) return;
+    e->lastused = texcachestamp;
+    texcachedirty = true;
+    l.cache.done = false;
+    l.cache.id = asyncreadfile(l.cache.name, texfileloaded, &l.cache);
+}
+
+static bool loadtexcache(texload &l)
+{
+    const texfile &c = l.cache;
+    if(!c.data || c.len < sizeof(texcacheheader)) return false;
+    texcacheheader h;
+    memcpy(&h, c.data, sizeof(h));
+    lilswap(&h.version, (sizeof(h) - sizeof(h.magic))/sizeof(int));
+    if(memcmp(h.magic, "TEXC", 4) || h.version != TEXCACHEVERSION) return false;
+    if(h.keylen != int(strlen(l.key)) || c.len < sizeof(h) + h.keylen || memcmp(c.data + sizeof(h), l.key, h.keylen)) return false;
+    if(h.w <= 0 || h.w > (1<<12) || h.h <= 0 || h.h > (1<<12) || h.bpp <= 0 || h.bpp > 16 || h.levels <= 0 || h.levels > 16 || (h.align != 0 && h.align != 4)) return false;
+    switch(h.compressed)
+    {
+        case 0: break;
+        case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+        case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+        case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+        case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+            if(!hasS3TC) return false;
+            break;
+        default: return false;
+    }
+    ImageData &d = l.image;
+    d.setdata(NULL, h.w, h.h, h.bpp, h.levels, h.align, h.compressed);
+    size_t size = d.calcsize();
+    if(c.len != sizeof(h) + h.keylen + size) { d.cleanup(); return false; }
+    memcpy(d.data, c.data + sizeof(h) + h.keylen, size);
+    l.compress = h.compress;
+    return true;
+}
+
+// stores what the texture was made from, or its S3TC mipmaps as the driver compressed them
+static void savetexcache(texload &l, Texture *t)
+{
+    if(!l.cache.name || !l.image.data) return;
+    const ImageData &s = l.image;
+    texcacheheader h;
+    memcpy(h.magic, "TEXC", 4);
+    h.version = TEXCACHEVERSION;
+    h.keylen = strlen(l.key);
+    h.w = s.w;
+    h.h = s.h;
+    h.bpp = s.bpp;
+    h.levels = 1;
+    h.align = 0;
+    h.compressed = GL_FALSE;
+    h.compress = l.compress;
+    if(s.compressed) return;
+
+    GLint compressed = 0, format = 0;
+    if(hasS3TC && t->mipmap && t->w == t->xs && t->h == t->ys)
+    {
+        glBindTexture(GL_TEXTURE_2D, t->id);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_COMPRESSED_ARB, &compressed);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &format);
+    }
+    int size = 0;
+    if(compressed) switch(format)
+    {
+        case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+        case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT: h.bpp = 8; break;
+        case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+        case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT: h.bpp = 16; break;
+        default: compressed = 0; break;
+    }
+    if(compressed)
+    {
+        h.w = t->w;
+        h.h = t->h;
+        h.align = 4;
+        h.compressed = format;
+        h.levels = 0;
+        for(int lw = h.w, lh = h.h;;)
+        {
+            GLint levelsize = 0;
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, h.levels++, GL_TEXTURE_COMPRESSED_IMAGE_SIZE_ARB, &levelsize);
+            if(levelsize != ((lw+3)/4)*((lh+3)/4)*h.bpp) return;
+            size += levelsize;
+            if(max(lw, lh) <= 1) break;
+            if(lw > 1) lw /= 2;
+            if(lh > 1) lh /= 2;
+        }
+    }
+    else size = s.w*s.h*s.bpp;
+
+    int len = sizeof(h) + h.keylen + size;
+    uchar *data = new uchar[len], *dst = data + sizeof(h) + h.keylen;
+    memcpy(data + sizeof(h), l.key, h.keylen);
+    if(compressed) for(int level = 0, lw = h.w, lh = h.h; level < h.levels; level++)
+    {
+        glGetCompressedTexImage_(GL_TEXTURE_2D, level, dst);
+        dst += ((lw+3)/4)*((lh+3)/4)*h.bpp;
+        if(lw > 1) lw /= 2;
+        if(lh > 1) lh /= 2;
+    }
+    else loopi(s.h)
+    {
+        memcpy(dst, &s.data[i*s.pitch], s.w*s.bpp);
+        dst += s.w*s.bpp;
+    }
+    lilswap(&h.version, (sizeof(h) - sizeof(h.magic))/sizeof(int));
+    memcpy(data, &h, sizeof(h));
+    asyncwritefile(l.cache.name, data, len);
+
+    texcacheentry &e = addtexcacheentry(texcachename(l));
+    e.size = len;
+    e.lastused = texcachestamp;
+    texcachedirty = true;
+}
+
+// the file texturedata() reads for a slot texture, or NULL if it has to be loaded on the main thread
+static const char *texloadfile(const Slot::Tex &t, string &file)
+{
+    const char *cmds = NULL, *name = t.name;
+    if(name[0]=='<')
+    {
+        cmds = name;
+        name = strrchr(name, '>');
+        if(!name) return NULL;
+        name++;
+    }
+    copystring(file, name);
+    path(file);
+    int flen = strlen(file);
+    if(flen >= 4 && !strcasecmp(file + flen - 4, ".dds")) return NULL;
+    for(const char *pcmds = cmds; pcmds;)
+    {
+        PARSETEXCOMMANDS(pcmds);
+        if(matchstring(cmd, len, "dds") || matchstring(cmd, len, "stub")) return NULL;
+    }
+    return file;
+}
+
+static bool addtexloadfile(texload &l, const Slot::Tex &t)
+{
+    string file;
+    if(!texloadfile(t, file)) return false;
+    loopv(l.files) if(!strcmp(l.files[i].name, file)) return true;
+    texfile &f = l.files.add();
+    f.name = newstring(file);
+    f.data = NULL;
+    f.len = 0;
+    f.id = -1;
+    f.done = false;
+    return true;
+}
+
+static void texfileloaded(int id, const char *name, bool ok, uchar *&data, size_t len, void *arg)
+{
+    texfile &f = *(texfile *)arg;
+    f.data = data;
+    f.len = len;
+    f.done = true;
+    data = NULL;
+}
+
+static void requesttexload(texload &l)
+{
+    loopv(l.files) l.files[i].id = asyncreadfile(l.files[i].name, texfileloaded, &l.files[i]);
+}
+
+static void waittexfile(texfile &f)
+{
+    if(!f.done && !waitasyncfile(f.id)) f.done = true;
+}
+
+static void waittexload(texload &l)
+{
+    loopv(l.files) waittexfile(l.files[i]);
+}
+
+static void decodetexload(void *data, int i, int thread)
+{
+    texload &l = *((texload **)data)[i];
+    Slot &s = *l.slot;
+    l.cached = loadtexcache(l);
+    l.ok = l.cached || texcombinedata(s, l.index, s.sts[l.index], l.image, l.compress, l.texmask, l.envmap, &l.files);
+}
+
+static void finishtexload(texload &l)
+{
+    Slot::Tex &t = l.slot->sts[l.index];
+    t.t = textures.access(l.key);
+    if(t.t) return;
+    if(!l.ok)
+    {
+        conoutf(CON_WARN, "could not load texture %s", t.name);
+        t.t = notexture;
+        return;
+    }
+    t.t = newtexture(NULL, l.key, l.image, 0, true, true, true, l.compress);
+    if(texcache && !l.cached) savetexcache(l, t.t);
+}
+
+static void markslots(cube *c, vector<Slot *> &used, int n = 8)
+{
+    loopi(n)
+    {
+        if(c[i].children) markslots(c[i].children, used);
+        else if(!isempty(c[i])) loopj(6) if(vslots.inrange(c[i].texture[j]))
+        {
+            VSlot &vs = *vslots[c[i].texture[j]];
+            if(vs.slot && !vs.slot->loaded && used.find(vs.slot) < 0) used.add(vs.slot);
+            if(vs.layer && vslots.inrange(vs.layer))
+            {
+                Slot *layer = vslots[vs.layer]->slot;
+                if(layer && !layer->loaded && used.find(layer) < 0) used.add(layer);
+            }
+        }
+    }
+}
+
+// loads the textures of all slots the world uses before its geometry is built
+void preloadslots()
+{
+    vector<Slot *> used;
+    markslots(worldroot, used);
+    if(used.empty()) return;
+
+    vector<texload *> loads, dups;
+    hashset<const char *> keys;
+    loopv(used)
+    {
+        Slot &s = *used[i];
+        linkslotshader(s);
+        loopvj(s.sts)
+        {
+            Slot::Tex &t = s.sts[j];
+            if(t.combined >= 0) continue;
+            if(t.type == TEX_ENVMAP)
+            {
+                if(hasCM && (renderpath != R_FIXEDFUNCTION || (s.shader->type&SHADER_ENVMAP && s.ffenv && maxtmus >= 2))) t.t = cubemapload(t.name);
+                continue;
+            }
+            vector<char> key;
+            int texmask = 0;
+            bool envmap = false;
+            if(!texcombinekey(s, j, t, false, key, texmask, envmap)) continue;
+            texload *l = new texload;
+            l->slot = &s;
+            l->index = j;
+            l->texmask = texmask;
+            l->envmap = envmap;
+            l->key = newstring(key.getbuf());
+            if(keys.access(l->key)) { dups.add(l); continue; }
+            bool async = addtexloadfile(*l, t);
+            loopvk(s.sts) if(s.sts[k].combined == j && !addtexloadfile(*l, s.sts[k])) async = false;
+            if(!async)
+            {
+                delete l;
+                int compress = 0;
+                ImageData ts;
+                if(!texcombinedata(s, j, t, ts, compress, texmask, envmap)) t.t = notexture;
+                else t.t = newtexture(NULL, key.getbuf(), ts, 0, true, true, true, compress);
+                continue;
+            }
+            keys.access(loads.add(l)->key, l->key);
+        }
+    }
+
+    // SDL_image sets up its decoders on first use, which must not race on the job threads
+    static bool imginit = false;
+    if(!imginit) { IMG_Init(IMG_INIT_JPG|IMG_INIT_PNG); imginit = true; }
+
+    if(texcache)
+    {
+        loadtexcacheindex();
+        texcachestamp++;
+    }
+
+    int batch = max(texloadbatch, numjobthreads()), requested = 0;
+    for(int start = 0; start < loads.length(); start += batch)
+    {
+        int end = min(start + batch, loads.length());
+        // keep the io threads a batch ahead of the decoding
+        for(; requested < min(end + batch, loads.length()); requested++) requesttexload(*loads[requested]);
+        for(int i = start; i < end; i++) waittexload(*loads[i]);
+        if(texcache)
+        {
+            runjobs(hashtexload, &loads[start], end - start);
+            for(int i = start; i < end; i++) requesttexcache(*loads[i]);
+            for(int i = start; i < end; i++) waittexfile(loads[i]->cache);
+        }
+        runjobs(decodetexload, &loads[start], end - start);
+        for(int i = start; i < end; i++) finishtexload(*loads[i]);
+        renderprogress(float(end)/loads.length(), "loading textures...");
+    }
+    loopv(dups) finishtexload(*dups[i]);
+    loads.deletecontents();
+    dups.deletecontents();
+
+    if(texcache)
+    {
+        evicttexcache();
+        savetexcacheindex();
+    }
+
+    loopv(used) used[i]->loaded = true;
+}
+
 MSlot &lookupmaterialslot(int index, bool load)
 {
     MSlot &s = materialslots[index];
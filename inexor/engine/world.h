@@ -61,6 +61,46 @@ struct compatheader
     char maptitle[128];
 };
 
+// chunked map container: the same byte stream as an .ogz, split at section
+// boundaries into independently compressed chunks, preceded by a table of contents
+#define MAPCHUNKVERSION 1
+#define MAXMAPCHUNKS 0x10000            // limits on the table of contents, which comes from untrusted files
+#define MAXMAPCHUNKSIZE (1<<27)
+
+enum
+{
+    MAPCHUNK_HEADER = 0,    // octaheader, vars, game data, texmru
+    MAPCHUNK_ENTS,
+    MAPCHUNK_VSLOTS,
+    MAPCHUNK_OCTREE,        // one per top level octree child
+    MAPCHUNK_LIGHTMAP,      // one per lightmap
+    MAPCHUNK_PVS,
+    MAPCHUNK_BLENDMAP,
+    NUMMAPCHUNKTYPES
+};
+
+enum
+{
+    MAPCODEC_STORED = 0,
+    MAPCODEC_ZLIB,
+    NUMMAPCODECS
+};
+
+struct mapchunkheader
+{
+    char magic[4];              // "OCTC"
+    int version;                // MAPCHUNKVERSION, little endian like everything else
+    int numchunks;
+};
+
+struct mapchunk
+{
+    int type, codec;
+    uint offset;                // file offset of the packed data
+    uint packedsize, rawsize;
+    uint crc;                   // crc32 of the raw data
+};
+
 // enumeration for material visibility
 enum 
 { 
@@ -3,6 +3,8 @@
 #include "inexor/engine/engine.h"
 #include "inexor/shared/filesystem.h"
 
+#include <sys/stat.h>
+
 /// remove map postfix (.ogz) from file path/name to get map name
 void cutogz(char *s) 
 {   
@@ -51,18 +53,191 @@ static void fixent(entity &e, int version)
 }
 
 
-/// load/parse entities from a file
-/// @param fname file name which conains compressed OGZ content (a map)
+/// reads the chunked map container as one continuous stream, identical to the
+/// contents of the equivalent .ogz; chunks are inflated on demand and seeking
+/// over whole chunks skips them without reading or inflating anything
+struct mapchunkstream : stream
+{
+    stream *file;
+    vector<mapchunk> chunks;
+    vector<uchar> packed, raw;
+    int nextchunk;
+    size_t readpos;
+    offset chunkstart;
+    uint crc;
+    bool reading;
+
+    mapchunkstream() : file(NULL), nextchunk(0), readpos(0), chunkstart(0), crc(0), reading(false) {}
+    ~mapchunkstream() { close(); }
+
+    bool open(stream *f)
+    {
+        mapchunkheader hdr;
+        if(f->read(&hdr, sizeof(hdr)) != sizeof(hdr) || memcmp(hdr.magic, "OCTC", 4)) return false;
+        lilswap(&hdr.version, 2);
+        if(hdr.version > MAPCHUNKVERSION || hdr.numchunks < 0 || hdr.numchunks > MAXMAPCHUNKS) return false;
+        offset filesize = f->size();
+        if(filesize <= 0) return false;
+        loopi(hdr.numchunks)
+        {
+            mapchunk &c = chunks.add();
+            if(f->read(&c, sizeof(mapchunk)) != sizeof(mapchunk)) return false;
+            lilswap(&c.type, 6);
+            // everything here is used for allocation and seeking, so reject anything inconsistent
+            if(c.type < 0 || c.type >= NUMMAPCHUNKTYPES || c.codec < 0 || c.codec >= NUMMAPCODECS) return false;
+            if(c.rawsize > MAXMAPCHUNKSIZE || c.packedsize > MAXMAPCHUNKSIZE) return false;
+            if(offset(c.offset) + offset(c.packedsize) > filesize) return false;
+            if(c.codec == MAPCODEC_STORED && c.packedsize != c.rawsize) return false;
+        }
+        file = f;
+        crc = crc32(0, NULL, 0);
+        reading = true;
+        return true;
+    }
+
+    void close()
+    {
+        reading = false;
+        DELETEP(file);
+    }
+
+    void releasechunk()
+    {
+        if(raw.empty()) return;
+        crc = crc32_combine(crc, chunks[nextchunk-1].crc, raw.length());
+        chunkstart += raw.length();
+        raw.setsize(0);
+        readpos = 0;
+    }
+
+    bool loadchunk()
+    {
+        releasechunk();
+        while(nextchunk < chunks.length())
+        {
+            mapchunk &c = chunks[nextchunk++];
+            if(!c.rawsize) continue;
+            if(!file->seek(c.offset, SEEK_SET)) break;
+            uchar *dst = raw.pad(c.rawsize);
+            if(c.codec == MAPCODEC_STORED)
+            {
+                if(c.packedsize != c.rawsize || file->read(dst, c.rawsize) != c.rawsize) break;
+            }
+            else if(c.codec == MAPCODEC_ZLIB)
+            {
+                packed.setsize(0);
+                uchar *src = packed.pad(c.packedsize);
+                uLongf len = c.rawsize;
+                if(file->read(src, c.packedsize) != c.packedsize || uncompress(dst, &len, src, c.packedsize) != Z_OK || len != c.rawsize) break;
+            }
+            else break;
+            if(crc32(crc32(0, NULL, 0), dst, c.rawsize) != c.crc) break;
+            return true;
+        }
+        raw.setsize(0);
+        reading = false;
+        return false;
+    }
+
+    bool end() { return !reading; }
+    offset tell() { return chunkstart + readpos; }
+    uint getcrc() { return raw.length() ? crc32(crc, raw.getbuf(), readpos) : crc; }
+
+    offset size()
+    {
+        offset total = 0;
+        loopv(chunks) total += chunks[i].rawsize;
+        return total;
+    }
+
+    bool skip(offset n)
+    {
+        while(n > 0)
+        {
+            if(readpos < size_t(raw.length()))
+            {
+                size_t skipped = (size_t)min(n, offset(raw.length() - readpos));
+                readpos += skipped;
+                n -= skipped;
+                continue;
+            }
+            releasechunk();
+            if(nextchunk >= chunks.length()) { reading = false; return false; }
+            mapchunk &c = chunks[nextchunk];
+            if(n >= c.rawsize)
+            {
+                crc = crc32_combine(crc, c.crc, c.rawsize);
+                chunkstart += c.rawsize;
+                n -= c.rawsize;
+                nextchunk++;
+            }
+            else if(!loadchunk()) return false;
+        }
+        return true;
+    }
+
+    bool seek(offset pos, int whence)
+    {
+        if(!reading) return false;
+        if(whence == SEEK_END)
+        {
+            skip(size() - tell());
+            return !pos;
+        }
+        else if(whence == SEEK_SET) pos -= tell();
+        return pos >= 0 && skip(pos);
+    }
+
+    size_t read(void *buf, size_t len)
+    {
+        if(!reading || !buf || !len) return 0;
+        size_t next = 0;
+        while(next < len)
+        {
+            if(readpos >= size_t(raw.length()) && !loadchunk()) break;
+            size_t n = min(len - next, raw.length() - readpos);
+            memcpy(&((uchar *)buf)[next], &raw[readpos], n);
+            next += n;
+            readpos += n;
+        }
+        return next;
+    }
+
+    int getchar()
+    {
+        if(readpos >= size_t(raw.length()) && (!reading || !loadchunk())) return -1;
+        return raw[readpos++];
+    }
+};
+
+/// open a map for reading, either in the chunked container or as a plain .ogz
+static stream *openmapfile(const char *name)
+{
+    stream *f = openfile(name, "rb");
+    if(!f) return NULL;
+    char magic[4];
+    bool chunked = f->read(magic, 4) == 4 && !memcmp(magic, "OCTC", 4);
+    if(chunked && f->seek(0, SEEK_SET))
+    {
+        mapchunkstream *m = new mapchunkstream;
+        if(m->open(f)) return m;
+        delete m;
+        delete f;
+        return NULL;
+    }
+    delete f;
+    return opengzfile(name, "rb");
+}
+
+
+/// parse entities from a map file
+/// @param ogzname path of the map file
 /// @param ents a reference to a vector of entites in which parsed entities from this file will be copied
 /// @param crc the CRC32 hash sum of this map
-/// @see getmapfilename
-bool loadents(const char *fname, vector<entity> &ents, uint *crc)
+/// @see loadents
+static bool parseents(const char *ogzname, vector<entity> &ents, uint *crc)
 {
-    string mapname, ogzname;
-    getmapfilename(fname, NULL, mapname);
-    formatstring(ogzname)("%s/%s.ogz", mapdir, mapname);
-    path(ogzname);
-    stream *f = opengzfile(ogzname, "rb");
+    stream *f = openmapfile(ogzname);
     if(!f) return false;
     octaheader hdr;
     if(f->read(&hdr, 7*sizeof(int)) != 7*sizeof(int)) { conoutf(CON_ERROR, "map %s has malformatted header", ogzname); delete f; return false; }
@@ -169,6 +344,80 @@ bool loadents(const char *fname, vector<entity> &ents, uint *crc)
     return true;
 }
 
+/// keep the entities and CRC of every map loadents() has seen, so changing
+/// to a known map does not have to read and inflate the map file again
+VAR(cachemapents, 0, 1, 1);
+
+struct mapentcache
+{
+    time_t mtime;
+    uint crc;
+    vector<entity> ents;
+};
+
+static hashtable<const char *, mapentcache *> mapentcaches;
+
+/// modification time of a map file on disk; maps inside zip packages have none and are not cached
+static bool getmapfiletime(const char *ogzname, time_t &mtime)
+{
+    if(findzipfile(ogzname)) return false;
+    const char *found = findfile(ogzname, "rb");
+    struct stat st;
+    if(!found || stat(found, &st) < 0) return false;
+    mtime = st.st_mtime;
+    return true;
+}
+
+/// load/parse entities from a map, using the cache when the file has not changed since it was cached
+/// @param fname file name which conains compressed OGZ content (a map)
+/// @param ents a reference to a vector of entites in which parsed entities from this file will be copied
+/// @param crc the CRC32 hash sum of this map
+/// @see getmapfilename
+bool loadents(const char *fname, vector<entity> &ents, uint *crc)
+{
+    string mapname, ogzname;
+    getmapfilename(fname, NULL, mapname);
+    formatstring(ogzname)("%s/%s.ogz", mapdir, mapname);
+    path(ogzname);
+
+    time_t mtime;
+    if(!cachemapents || !getmapfiletime(ogzname, mtime)) return parseents(ogzname, ents, crc);
+
+    mapentcache *c = mapentcaches.find(ogzname, NULL);
+    if(!c || c->mtime != mtime)
+    {
+        vector<entity> parsed;
+        uint parsedcrc = 0;
+        if(!parseents(ogzname, parsed, &parsedcrc)) return false;
+        if(!c) c = mapentcaches[newstring(ogzname)] = new mapentcache;
+        c->mtime = mtime;
+        c->crc = parsedcrc;
+        c->ents.setsize(0);
+        c->ents.put(parsed.getbuf(), parsed.length());
+    }
+    ents.put(c->ents.getbuf(), c->ents.length());
+    if(crc) *crc = c->crc;
+    return true;
+}
+
+/// fill the entity cache for a map ahead of time, e.g. for every map of the rotation on startup
+bool precachemapents(const char *fname)
+{
+    vector<entity> ents;
+    return loadents(fname, ents);
+}
+
+void clearmapentcache()
+{
+    enumeratekt(mapentcaches, const char *, name, mapentcache *, c,
+    {
+        delete[] (char *)name;
+        delete c;
+    });
+    mapentcaches.clear();
+}
+COMMAND(clearmapentcache, "");
+
 
 
 
@@ -247,177 +496,186 @@ enum
 static int savemapprogress = 0;
 
 
-/// save OCTREE (and its children) to stream (file)
-/// this file calls itself (recursion) because of the OCTREE's structure
-/// @param c the cube (or child of a parent's cube) which contains the OCTREE data
-/// @param o a reference to an integer vector [mathematic vector]
-/// @param size the size of the stream
+void savec(cube *c, const ivec &o, int size, stream *f, bool nolms);
+
+/// save a single OCTREE cube (and its children) to stream (file)
+/// @param c the cube which contains the OCTREE data
+/// @param co the position of the cube
+/// @param size the size of the cube
 /// @param f the stream to which data will be written
 /// @param nolms save without lightmaps
-/// @see 
-void savec(cube *c, const ivec &o, int size, stream *f, bool nolms)
+/// @see savec
+static void savecube(cube &c, const ivec &co, int size, stream *f, bool nolms)
 {
-    /// render progress bar in the background
-    if((savemapprogress++&0xFFF)==0) renderprogress(float(savemapprogress)/allocnodes, "saving octree...");
-
-    loopi(8)
+    if(c.children)
     {
-        ivec co(i, o.x, o.y, o.z, size);
-        if(c[i].children)
-        {
-            f->putchar(OCTSAV_CHILDREN);
-            /// save children (recursion!)
-            savec(c[i].children, co, size>>1, f, nolms);
-        }
+        f->putchar(OCTSAV_CHILDREN);
+        /// save children (recursion!)
+        savec(c.children, co, size>>1, f, nolms);
+    }
+    else
+    {
+        int oflags = 0, surfmask = 0, totalverts = 0;
+        if(c.material!=MAT_AIR) oflags |= 0x40;
+        if(isempty(c)) f->putchar(oflags | OCTSAV_EMPTY);
         else
         {
-            int oflags = 0, surfmask = 0, totalverts = 0;
-            if(c[i].material!=MAT_AIR) oflags |= 0x40;
-            if(isempty(c[i])) f->putchar(oflags | OCTSAV_EMPTY);
-            else
+            /// lightmaps will be saved
+            if(!nolms)
             {
-                /// lightmaps will be saved
-                if(!nolms)
+                if(c.merged) oflags |= 0x80;
+                if(c.ext) loopj(6) 
                 {
-                    if(c[i].merged) oflags |= 0x80;
-                    if(c[i].ext) loopj(6) 
-                    {
-                        const surfaceinfo &surf = c[i].ext->surfaces[j];
-                        if(!surf.used()) continue;
-                        oflags |= 0x20; 
-                        surfmask |= 1<<j; 
-                        totalverts += surf.totalverts(); 
-                    }
+                    const surfaceinfo &surf = c.ext->surfaces[j];
+                    if(!surf.used()) continue;
+                    oflags |= 0x20; 
+                    surfmask |= 1<<j; 
+                    totalverts += surf.totalverts(); 
                 }
+            }
 
-                if(isentirelysolid(c[i])) f->putchar(oflags | OCTSAV_SOLID);
-                else
-                {
-                    f->putchar(oflags | OCTSAV_NORMAL);
-                    f->write(c[i].edges, 12);
-                }
+            if(isentirelysolid(c)) f->putchar(oflags | OCTSAV_SOLID);
+            else
+            {
+                f->putchar(oflags | OCTSAV_NORMAL);
+                f->write(c.edges, 12);
             }
-            /// texture coordinates
-            loopj(6) f->putlil<ushort>(c[i].texture[j]);
+        }
+        /// texture coordinates
+        loopj(6) f->putlil<ushort>(c.texture[j]);
 
-            /// material type
-            if(oflags&0x40) f->putlil<ushort>(c[i].material);
-            if(oflags&0x80) f->putchar(c[i].merged);
-            if(oflags&0x20) 
+        /// material type
+        if(oflags&0x40) f->putlil<ushort>(c.material);
+        if(oflags&0x80) f->putchar(c.merged);
+        if(oflags&0x20) 
+        {
+            f->putchar(surfmask);
+            f->putchar(totalverts);
+            loopj(6) if(surfmask&(1<<j))
             {
-                f->putchar(surfmask);
-                f->putchar(totalverts);
-                loopj(6) if(surfmask&(1<<j))
+                surfaceinfo surf = c.ext->surfaces[j];
+                vertinfo *verts = c.ext->verts() + surf.verts;
+                int layerverts = surf.numverts&MAXFACEVERTS, numverts = surf.totalverts(), 
+                    vertmask = 0, vertorder = 0, uvorder = 0,
+                    dim = dimension(j), vc = C[dim], vr = R[dim];
+                if(numverts)
                 {
-                    surfaceinfo surf = c[i].ext->surfaces[j];
-                    vertinfo *verts = c[i].ext->verts() + surf.verts;
-                    int layerverts = surf.numverts&MAXFACEVERTS, numverts = surf.totalverts(), 
-                        vertmask = 0, vertorder = 0, uvorder = 0,
-                        dim = dimension(j), vc = C[dim], vr = R[dim];
-                    if(numverts)
+                    if(c.merged&(1<<j)) 
                     {
-                        if(c[i].merged&(1<<j)) 
+                        vertmask |= 0x04;
+                        if(layerverts == 4)
                         {
-                            vertmask |= 0x04;
-                            if(layerverts == 4)
+                            ivec v[4] = { verts[0].getxyz(), verts[1].getxyz(), verts[2].getxyz(), verts[3].getxyz() };
+                            loopk(4) 
                             {
-                                ivec v[4] = { verts[0].getxyz(), verts[1].getxyz(), verts[2].getxyz(), verts[3].getxyz() };
-                                loopk(4) 
+                                const ivec &v0 = v[k], &v1 = v[(k+1)&3], &v2 = v[(k+2)&3], &v3 = v[(k+3)&3];
+                                if(v1[vc] == v0[vc] && v1[vr] == v2[vr] && v3[vc] == v2[vc] && v3[vr] == v0[vr])
                                 {
-                                    const ivec &v0 = v[k], &v1 = v[(k+1)&3], &v2 = v[(k+2)&3], &v3 = v[(k+3)&3];
-                                    if(v1[vc] == v0[vc] && v1[vr] == v2[vr] && v3[vc] == v2[vc] && v3[vr] == v0[vr])
-                                    {
-                                        vertmask |= 0x01;
-                                        vertorder = k;
-                                        break;
-                                    }
+                                    vertmask |= 0x01;
+                                    vertorder = k;
+                                    break;
                                 }
                             }
                         }
-                        else
-                        {
-                            int vis = visibletris(c[i], j, co.x, co.y, co.z, size);
-                            if(vis&4 || faceconvexity(c[i], j) < 0) vertmask |= 0x01;
-                            if(layerverts < 4 && vis&2) vertmask |= 0x02; 
-                        }
-                        bool matchnorm = true;
-                        loopk(numverts) 
-                        { 
-                            const vertinfo &v = verts[k]; 
-                            if(v.u || v.v) vertmask |= 0x40; 
-                            if(v.norm) { vertmask |= 0x80; if(v.norm != verts[0].norm) matchnorm = false; }
-                        }
-                        if(matchnorm) vertmask |= 0x08;
-                        if(vertmask&0x40 && layerverts == 4)
+                    }
+                    else
+                    {
+                        int vis = visibletris(c, j, co.x, co.y, co.z, size);
+                        if(vis&4 || faceconvexity(c, j) < 0) vertmask |= 0x01;
+                        if(layerverts < 4 && vis&2) vertmask |= 0x02; 
+                    }
+                    bool matchnorm = true;
+                    loopk(numverts) 
+                    { 
+                        const vertinfo &v = verts[k]; 
+                        if(v.u || v.v) vertmask |= 0x40; 
+                        if(v.norm) { vertmask |= 0x80; if(v.norm != verts[0].norm) matchnorm = false; }
+                    }
+                    if(matchnorm) vertmask |= 0x08;
+                    if(vertmask&0x40 && layerverts == 4)
+                    {
+                        loopk(4)
                         {
-                            loopk(4)
+                            const vertinfo &v0 = verts[k], &v1 = verts[(k+1)&3], &v2 = verts[(k+2)&3], &v3 = verts[(k+3)&3];
+                            if(v1.u == v0.u && v1.v == v2.v && v3.u == v2.u && v3.v == v0.v)
                             {
-                                const vertinfo &v0 = verts[k], &v1 = verts[(k+1)&3], &v2 = verts[(k+2)&3], &v3 = verts[(k+3)&3];
-                                if(v1.u == v0.u && v1.v == v2.v && v3.u == v2.u && v3.v == v0.v)
+                                if(surf.numverts&LAYER_DUP)
                                 {
-                                    if(surf.numverts&LAYER_DUP)
-                                    {
-                                        const vertinfo &b0 = verts[4+k], &b1 = verts[4+((k+1)&3)], &b2 = verts[4+((k+2)&3)], &b3 = verts[4+((k+3)&3)];
-                                        if(b1.u != b0.u || b1.v != b2.v || b3.u != b2.u || b3.v != b0.v)
-                                            continue;
-                                    }
-                                    uvorder = k;
-                                    vertmask |= 0x02 | (((k+4-vertorder)&3)<<4);
-                                    break;
+                                    const vertinfo &b0 = verts[4+k], &b1 = verts[4+((k+1)&3)], &b2 = verts[4+((k+2)&3)], &b3 = verts[4+((k+3)&3)];
+                                    if(b1.u != b0.u || b1.v != b2.v || b3.u != b2.u || b3.v != b0.v)
+                                        continue;
                                 }
-                            } 
-                        }
+                                uvorder = k;
+                                vertmask |= 0x02 | (((k+4-vertorder)&3)<<4);
+                                break;
+                            }
+                        } 
                     }
-                    surf.verts = vertmask;
-                    /// surface information
-                    f->write(&surf, sizeof(surfaceinfo));
-                    bool hasxyz = (vertmask&0x04)!=0, hasuv = (vertmask&0x40)!=0, hasnorm = (vertmask&0x80)!=0;
-                    if(layerverts == 4)
+                }
+                surf.verts = vertmask;
+                /// surface information
+                f->write(&surf, sizeof(surfaceinfo));
+                bool hasxyz = (vertmask&0x04)!=0, hasuv = (vertmask&0x40)!=0, hasnorm = (vertmask&0x80)!=0;
+                if(layerverts == 4)
+                {
+                    if(hasxyz && vertmask&0x01)
                     {
-                        if(hasxyz && vertmask&0x01)
-                        {
-                            ivec v0 = verts[vertorder].getxyz(), v2 = verts[(vertorder+2)&3].getxyz();
-                            f->putlil<ushort>(v0[vc]); f->putlil<ushort>(v0[vr]);
-                            f->putlil<ushort>(v2[vc]); f->putlil<ushort>(v2[vr]);
-                            hasxyz = false;
-                        }
-                        if(hasuv && vertmask&0x02)
-                        {
-                            const vertinfo &v0 = verts[uvorder], &v2 = verts[(uvorder+2)&3];
-                            f->putlil<ushort>(v0.u); f->putlil<ushort>(v0.v);
-                            f->putlil<ushort>(v2.u); f->putlil<ushort>(v2.v);
-                            if(surf.numverts&LAYER_DUP)
-                            {
-                                const vertinfo &b0 = verts[4+uvorder], &b2 = verts[4+((uvorder+2)&3)];
-                                f->putlil<ushort>(b0.u); f->putlil<ushort>(b0.v);
-                                f->putlil<ushort>(b2.u); f->putlil<ushort>(b2.v);
-                            }
-                            hasuv = false;
-                        }
+                        ivec v0 = verts[vertorder].getxyz(), v2 = verts[(vertorder+2)&3].getxyz();
+                        f->putlil<ushort>(v0[vc]); f->putlil<ushort>(v0[vr]);
+                        f->putlil<ushort>(v2[vc]); f->putlil<ushort>(v2[vr]);
+                        hasxyz = false;
                     }
-                    if(hasnorm && vertmask&0x08) { f->putlil<ushort>(verts[0].norm); hasnorm = false; }
-                    if(hasxyz || hasuv || hasnorm) loopk(layerverts)
+                    if(hasuv && vertmask&0x02)
                     {
-                        const vertinfo &v = verts[(k+vertorder)%layerverts];
-                        if(hasxyz) 
+                        const vertinfo &v0 = verts[uvorder], &v2 = verts[(uvorder+2)&3];
+                        f->putlil<ushort>(v0.u); f->putlil<ushort>(v0.v);
+                        f->putlil<ushort>(v2.u); f->putlil<ushort>(v2.v);
+                        if(surf.numverts&LAYER_DUP)
                         {
-                            ivec xyz = v.getxyz(); 
-                            f->putlil<ushort>(xyz[vc]); f->putlil<ushort>(xyz[vr]); 
+                            const vertinfo &b0 = verts[4+uvorder], &b2 = verts[4+((uvorder+2)&3)];
+                            f->putlil<ushort>(b0.u); f->putlil<ushort>(b0.v);
+                            f->putlil<ushort>(b2.u); f->putlil<ushort>(b2.v);
                         }
-                        if(hasuv) { f->putlil<ushort>(v.u); f->putlil<ushort>(v.v); }
-                        if(hasnorm) f->putlil<ushort>(v.norm); 
+                        hasuv = false;
                     }
-                    if(surf.numverts&LAYER_DUP) loopk(layerverts)
+                }
+                if(hasnorm && vertmask&0x08) { f->putlil<ushort>(verts[0].norm); hasnorm = false; }
+                if(hasxyz || hasuv || hasnorm) loopk(layerverts)
+                {
+                    const vertinfo &v = verts[(k+vertorder)%layerverts];
+                    if(hasxyz) 
                     {
-                        const vertinfo &v = verts[layerverts + (k+vertorder)%layerverts];
-                        if(hasuv) { f->putlil<ushort>(v.u); f->putlil<ushort>(v.v); }
+                        ivec xyz = v.getxyz(); 
+                        f->putlil<ushort>(xyz[vc]); f->putlil<ushort>(xyz[vr]); 
                     }
+                    if(hasuv) { f->putlil<ushort>(v.u); f->putlil<ushort>(v.v); }
+                    if(hasnorm) f->putlil<ushort>(v.norm); 
+                }
+                if(surf.numverts&LAYER_DUP) loopk(layerverts)
+                {
+                    const vertinfo &v = verts[layerverts + (k+vertorder)%layerverts];
+                    if(hasuv) { f->putlil<ushort>(v.u); f->putlil<ushort>(v.v); }
                 }
             }
         }
     }
 }
 
+/// save OCTREE (and its children) to stream (file)
+/// this file calls itself (recursion) because of the OCTREE's structure
+/// @param c the 8 children of a parent cube which contain the OCTREE data
+/// @param o a reference to an integer vector [mathematic vector]
+/// @param size the size of each child
+/// @param f the stream to which data will be written
+/// @param nolms save without lightmaps
+void savec(cube *c, const ivec &o, int size, stream *f, bool nolms)
+{
+    /// render progress bar in the background
+    if((savemapprogress++&0xFFF)==0) renderprogress(float(savemapprogress)/allocnodes, "saving octree...");
+
+    loopi(8) savecube(c[i], ivec(i, o.x, o.y, o.z, size), size, f, nolms);
+}
+
 
 /// surface description
 struct surfacecompat
@@ -986,10 +1244,129 @@ void loadvslots(stream *f, int numvslots)
 
 
 
+/// save maps in the chunked container instead of a single gzip stream
+VARP(savemapchunks, 0, 0, 1);
+/// zlib level used for map chunks, 0 stores them uncompressed
+VARP(mapchunklevel, 0, 1, 9);
+/// zlib level used for plain .ogz maps
+VARP(mapsavelevel, 0, 9, 9);
+
+/// collects the map byte stream and splits it into independently compressed
+/// chunks at every beginchunk(); the container is written out on close
+struct mapchunkwriter : stream
+{
+    stream *file;
+    vector<mapchunk> chunks;
+    vector<uchar> raw, packed;
+    int curtype, level;
+    bool writing;
+
+    mapchunkwriter() : file(NULL), curtype(-1), level(Z_BEST_SPEED), writing(false) {}
+    ~mapchunkwriter() { close(); }
+
+    bool open(stream *f, int complevel)
+    {
+        if(file) return false;
+        file = f;
+        level = complevel;
+        curtype = MAPCHUNK_HEADER;
+        writing = true;
+        return true;
+    }
+
+    void flushchunk()
+    {
+        if(curtype < 0) return;
+        mapchunk &c = chunks.add();
+        c.type = curtype;
+        c.rawsize = raw.length();
+        c.crc = crc32(crc32(0, NULL, 0), raw.getbuf(), raw.length());
+        c.offset = packed.length();
+        uLongf len = compressBound(raw.length());
+        uchar *dst = packed.reserve(len).buf;
+        if(level > 0 && raw.length() && compress2(dst, &len, raw.getbuf(), raw.length(), level) == Z_OK && len < uLongf(raw.length()))
+            c.codec = MAPCODEC_ZLIB;
+        else
+        {
+            len = raw.length();
+            memcpy(dst, raw.getbuf(), len);
+            c.codec = MAPCODEC_STORED;
+        }
+        packed.advance(len);
+        c.packedsize = len;
+        raw.setsize(0);
+    }
+
+    void beginchunk(int type)
+    {
+        flushchunk();
+        curtype = type;
+    }
+
+    bool finish()
+    {
+        flushchunk();
+        curtype = -1;
+        mapchunkheader hdr;
+        memcpy(hdr.magic, "OCTC", 4);
+        hdr.version = MAPCHUNKVERSION;
+        hdr.numchunks = chunks.length();
+        lilswap(&hdr.version, 2);
+        if(file->write(&hdr, sizeof(hdr)) != sizeof(hdr)) return false;
+        uint dataoffset = sizeof(hdr) + chunks.length()*sizeof(mapchunk);
+        loopv(chunks)
+        {
+            mapchunk c = chunks[i];
+            c.offset += dataoffset;
+            lilswap(&c.type, 6);
+            if(file->write(&c, sizeof(mapchunk)) != sizeof(mapchunk)) return false;
+        }
+        return file->write(packed.getbuf(), packed.length()) == size_t(packed.length());
+    }
+
+    void close()
+    {
+        if(writing && !finish()) conoutf(CON_ERROR, "could not write map chunks");
+        writing = false;
+        DELETEP(file);
+    }
+
+    bool end() { return !writing; }
+    offset tell() { return writing ? offset(raw.length()) : offset(-1); }
+    size_t write(const void *buf, size_t len)
+    {
+        if(!writing || !buf || !len) return 0;
+        // sections larger than a chunk are continued in further chunks of the same type
+        const uchar *src = (const uchar *)buf;
+        for(size_t left = len; left > 0;)
+        {
+            if(raw.length() >= MAXMAPCHUNKSIZE) beginchunk(curtype);
+            size_t n = min(left, size_t(MAXMAPCHUNKSIZE - raw.length()));
+            raw.put(src, int(n));
+            src += n;
+            left -= n;
+        }
+        return len;
+    }
+    bool putchar(int c)
+    {
+        if(!writing) return false;
+        if(raw.length() >= MAXMAPCHUNKSIZE) beginchunk(curtype);
+        raw.add(uchar(c));
+        return true;
+    }
+};
+
+static inline void beginmapchunk(mapchunkwriter *chunks, int type)
+{
+    if(chunks) chunks->beginchunk(type);
+}
+
 /// save the current game world to a map file (.OGZ)
 /// @param mname map name
 /// @param nolms enable or disable lightmap loading
-/// @warning map stream will be compressed using GZIP automaticly!
+/// @warning map stream will be compressed using GZIP automaticly, or split into
+///          compressed chunks if savemapchunks is set!
 bool save_world(const char *mname, bool nolms)
 {
     /// validate map name
@@ -998,7 +1375,19 @@ bool save_world(const char *mname, bool nolms)
     /// eventually save backup file
     if(savebak) backup(ogzname, bakname);
     /// open output stream
-    stream *f = opengzfile(ogzname, "wb");
+    mapchunkwriter *chunks = NULL;
+    stream *f = NULL;
+    if(savemapchunks)
+    {
+        stream *out = openfile(ogzname, "wb");
+        if(out)
+        {
+            chunks = new mapchunkwriter;
+            chunks->open(out, mapchunklevel);
+            f = chunks;
+        }
+    }
+    else f = opengzfile(ogzname, "wb", NULL, mapsavelevel);
     if(!f) 
     {
         conoutf(CON_WARN, "could not write map to %s", ogzname); 
@@ -1083,6 +1472,7 @@ bool save_world(const char *mname, bool nolms)
     loopv(texmru) f->putlil<ushort>(texmru[i]);
 
     /// save "extra entities" ?
+    beginmapchunk(chunks, MAPCHUNK_ENTS);
     char *ebuf = new char[entities::extraentinfosize()];
     loopv(ents)
     {
@@ -1099,11 +1489,17 @@ bool save_world(const char *mname, bool nolms)
     delete[] ebuf;
 
     /// vertex shader slots?
+    beginmapchunk(chunks, MAPCHUNK_VSLOTS);
     savevslots(f, numvslots);
 
     /// save octree structure and display another progress bar menawhile
+    /// (every top level child goes into a chunk of its own)
     renderprogress(0, "saving octree...");
-    savec(worldroot, ivec(0, 0, 0), worldsize>>1, f, nolms);
+    loopi(8)
+    {
+        beginmapchunk(chunks, MAPCHUNK_OCTREE);
+        savecube(worldroot[i], ivec(i, 0, 0, 0, worldsize>>1), worldsize>>1, f, nolms);
+    }
 
     if(!nolms) 
     {
@@ -1111,6 +1507,7 @@ bool save_world(const char *mname, bool nolms)
         loopv(lightmaps)
         {
             LightMap &lm = lightmaps[i];
+            beginmapchunk(chunks, MAPCHUNK_LIGHTMAP);
             f->putchar(lm.type | (lm.unlitx>=0 ? 0x80 : 0));
             if(lm.unlitx>=0)
             {
@@ -1120,9 +1517,9 @@ bool save_world(const char *mname, bool nolms)
             f->write(lm.data, lm.bpp*LM_PACKW*LM_PACKH);
             renderprogress(float(i+1)/lightmaps.length(), "saving lightmaps...");
         }
-        if(getnumviewcells()>0) { renderprogress(0, "saving pvs..."); savepvs(f); }
+        if(getnumviewcells()>0) { renderprogress(0, "saving pvs..."); beginmapchunk(chunks, MAPCHUNK_PVS); savepvs(f); }
     }
-    if(shouldsaveblendmap()) { renderprogress(0, "saving blendmap..."); saveblendmap(f); }
+    if(shouldsaveblendmap()) { renderprogress(0, "saving blendmap..."); beginmapchunk(chunks, MAPCHUNK_BLENDMAP); saveblendmap(f); }
 
     delete f;
     /// done
@@ -1173,12 +1570,16 @@ void clearmapcrc()
 }
 
 
+/// inflate the map on a separate thread while the octree is being decoded
+VARP(mapprefetch, 0, 1, 1);
+
 bool load_world(const char *mname, const char *cname)        // still supports all map formats that have existed since the earliest cube betas!
 {
     int loadingstart = SDL_GetTicks();
     setmapfilenames(mname, cname);
-    stream *f = opengzfile(ogzname, "rb");
+    stream *f = openmapfile(ogzname);
     if(!f) { conoutf(CON_ERROR, "could not read map %s", ogzname); return false; }
+    if(mapprefetch) f = openprefetchstream(f);
     octaheader hdr;
     if(f->read(&hdr, 7*sizeof(int)) != 7*sizeof(int)) { conoutf(CON_ERROR, "map %s has malformatted header", ogzname); delete f; return false; }
     lilswap(&hdr.version, 6);
@@ -1438,6 +1839,7 @@ bool load_world(const char *mname, const char *cname)        // still supports a
     attachentities();
     initlights();
     allchanged(true);
+    flushpreloadedsounds();
 
     renderbackground("loading...", mapshot, mname, game::getmapinfo());
 
@@ -62,7 +62,7 @@ namespace ai
         return e->state == CS_ALIVE && !isteam(d->team, e->team);
     }
 
-    bool getsight(vec &o, float yaw, float pitch, vec &q, vec &v, float mdist, float fovx, float fovy)
+    static inline bool infov(const vec &o, float yaw, float pitch, const vec &q, float mdist, float fovx, float fovy)
     {
         float dist = o.dist(q);
 
@@ -70,16 +70,134 @@ namespace ai
         {
             float x = fmod(fabs(asin((q.z-o.z)/dist)/RAD-pitch), 360);
             float y = fmod(fabs(-atan2(q.x-o.x, q.y-o.y)/RAD-yaw), 360);
-            if(min(x, 360-x) <= fovx && min(y, 360-y) <= fovy) return raycubelos(o, q, v);
+            return min(x, 360-x) <= fovx && min(y, 360-y) <= fovy;
         }
         return false;
     }
 
+    static inline bool infov(fpsent *d, const vec &x, const vec &y)
+    {
+        return infov(x, d->yaw, d->pitch, y, d->ai->views[2], d->ai->views[0], d->ai->views[1]);
+    }
+
+    // sense phase: the line of sight tests the ai is going to make this frame are done up front,
+    // spread over the job threads, while think() itself stays serial and consumes the results
+    struct sightcheck
+    {
+        fpsent *d;
+        vec from, to, hit;
+        int result;
+    };
+
+    #define SIGHTBATCH 8
+
+    VARP(aithreads, 0, 1, 1);
+
+    static vector<sightcheck> sightchecks;
+    static ShadowRayCache *sightcaches[MAXJOBTHREADS];
+    static int sightcachegen[MAXJOBTHREADS], sightgeneration = 0;
+
+    static void sightjob(void *data, int index, int thread)
+    {
+        // each thread index belongs to one thread while the jobs run, so its cache needs no lock
+        ShadowRayCache *&cache = sightcaches[thread];
+        if(sightcachegen[thread] != sightgeneration)
+        {
+            if(!cache) cache = newshadowraycache();
+            resetshadowraycache(cache);
+            sightcachegen[thread] = sightgeneration;
+        }
+        sightcheck &s = ((sightcheck *)data)[index];
+        s.result = raycubelos(cache, s.from, s.to, s.hit);
+    }
+
+    // route search scratch space, one per job thread; think() runs on the main thread, which is thread 0
+    static routestate *routestates[MAXJOBTHREADS];
+
+    static routestate &threadroutestate(int thread)
+    {
+        if(!routestates[thread]) routestates[thread] = newroutestate();
+        return *routestates[thread];
+    }
+
+    // the caches hold clip planes and route scores of the current map, so they go with it;
+    // the next sense() and route() build new ones
+    void cleanup()
+    {
+        sightchecks.setsize(0);
+        loopi(MAXJOBTHREADS)
+        {
+            if(sightcaches[i]) freeshadowraycache(sightcaches[i]);
+            if(routestates[i]) freeroutestate(routestates[i]);
+        }
+    }
+
+    static vec aimpos(fpsent *d, fpsent *e);
+
+    static void addsightcheck(fpsent *d, const vec &dp, fpsent *e)
+    {
+        if(e == d || !targetable(d, e)) return;
+        vec ep = aimpos(d, e);
+        if(!infov(d, dp, ep)) return;
+        sightcheck &s = sightchecks.add();
+        s.d = d;
+        s.from = dp;
+        s.to = ep;
+        s.result = -1;
+    }
+
+    static void sense()
+    {
+        sightchecks.setsize(0);
+        if(!aithreads) return;
+        int count = 0;
+        loopv(players)
+        {
+            fpsent *d = players[i];
+            if(!d->ai) continue;
+            // same order as update(), so this is the bot whose states run this frame
+            bool run = ++count == iteration;
+            d->ai->sightstart = sightchecks.length();
+            // a pending aim offset reroll would move every target point, so there is nothing to precompute
+            if(canmove(d) && d->ai->getstate().type != AI_S_WAIT && (d->skill > 100 || lastmillis < d->ai->lastaimrnd))
+            {
+                vec dp = d->headpos();
+                // a bot with an enemy only looks at it, unless its states run and scan for targets;
+                // any other test think() happens to make falls back to raycubelos inline
+                fpsent *e = getclient(d->ai->enemy);
+                if(!run && e && targetable(d, e)) addsightcheck(d, dp, e);
+                else loopvj(players) addsightcheck(d, dp, players[j]);
+            }
+            d->ai->numsights = sightchecks.length() - d->ai->sightstart;
+        }
+        if(sightchecks.empty()) return;
+
+        sightgeneration++;
+        runjobs(sightjob, sightchecks.getbuf(), sightchecks.length(), SIGHTBATCH);
+    }
+
+    static int sensed(fpsent *d, const vec &x, const vec &y, vec &targ)
+    {
+        for(int i = d->ai->sightstart, end = i + d->ai->numsights; i < end && sightchecks.inrange(i); i++)
+        {
+            sightcheck &s = sightchecks[i];
+            if(s.d == d && s.result >= 0 && s.from == x && s.to == y)
+            {
+                targ = s.hit;
+                return s.result;
+            }
+        }
+        return -1;
+    }
+
     bool cansee(fpsent *d, vec &x, vec &y, vec &targ)
     {
         aistate &b = d->ai->getstate();
-        if(canmove(d) && b.type != AI_S_WAIT)
-            return getsight(x, d->yaw, d->pitch, y, targ, d->ai->views[2], d->ai->views[0], d->ai->views[1]);
+        if(canmove(d) && b.type != AI_S_WAIT && infov(d, x, y))
+        {
+            int seen = sensed(d, x, y, targ);
+            return seen >= 0 ? seen > 0 : raycubelos(x, y, targ);
+        }
         return false;
     }
 
@@ -109,24 +227,26 @@ namespace ai
         return false;
 	}
 
-    vec getaimpos(fpsent *d, fpsent *e)
+    static vec aimpos(fpsent *d, fpsent *e)
     {
         vec o = e->o;
         if(d->gunselect == GUN_RL) o.z += (e->aboveeye*0.2f)-(0.8f*d->eyeheight);
         else if(d->gunselect != GUN_GL) o.z += (e->aboveeye-e->eyeheight)*0.5f;
-        if(d->skill <= 100)
+        if(d->skill <= 100) loopk(3) o[k] += d->ai->aimrnd[k];
+        return o;
+    }
+
+    vec getaimpos(fpsent *d, fpsent *e)
+    {
+        if(d->skill <= 100 && lastmillis >= d->ai->lastaimrnd)
         {
-            if(lastmillis >= d->ai->lastaimrnd)
-            {
-                const int aiskew[NUMGUNS] = { 1, 10, 50, 5, 20, 1, 100, 1, 10, 10, 10, 1, 1 };
-                #define rndaioffset(r) ((rnd(int(r*aiskew[d->gunselect]*2)+1)-(r*aiskew[d->gunselect]))*(1.f/float(max(d->skill, 1))))
-                loopk(3) d->ai->aimrnd[k] = rndaioffset(e->radius);
-                int dur = (d->skill+10)*10;
-                d->ai->lastaimrnd = lastmillis+dur+rnd(dur);
-            }
-            loopk(3) o[k] += d->ai->aimrnd[k];
+            const int aiskew[NUMGUNS] = { 1, 10, 50, 5, 20, 1, 100, 1, 10, 10, 10, 1, 1 };
+            #define rndaioffset(r) ((rnd(int(r*aiskew[d->gunselect]*2)+1)-(r*aiskew[d->gunselect]))*(1.f/float(max(d->skill, 1))))
+            loopk(3) d->ai->aimrnd[k] = rndaioffset(e->radius);
+            int dur = (d->skill+10)*10;
+            d->ai->lastaimrnd = lastmillis+dur+rnd(dur);
         }
-        return o;
+        return aimpos(d, e);
     }
 
     void create(fpsent *d)
@@ -201,6 +321,7 @@ namespace ai
                 iteration = 1;
                 itermillis = totalmillis;
             }
+            sense();
             int count = 0;
             loopv(players) if(players[i]->ai) think(players[i], ++count == iteration ? true : false);
             if(++iteration > count) iteration = 0;
@@ -230,7 +351,7 @@ namespace ai
     {
         if(!iswaypoint(d->lastnode)) return false;
 		if(changed && d->ai->route.length() > 1 && d->ai->route[0] == node) return true;
-		if(route(d, d->lastnode, node, d->ai->route, obstacles, retries))
+		if(route(threadroutestate(0), d, d->lastnode, node, d->ai->route, obstacles, retries))
 		{
 			b.override = false;
 			return true;
@@ -846,7 +967,7 @@ namespace ai
                     if(!d->ai->hasprevnode(t) && !obstacles.find(t, d))
                     {
                         static vector<int> remap; remap.setsize(0);
-                        if(route(d, w, t, remap, obstacles))
+                        if(route(threadroutestate(0), d, w, t, remap, obstacles))
                         { // kill what we don't want and put the remap in
                             while(d->ai->route.length() > i) d->ai->route.pop();
                             loopvk(remap) d->ai->route.add(remap[k]);
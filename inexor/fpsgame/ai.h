@@ -24,15 +24,11 @@ namespace ai
     struct waypoint
     {
         vec o;
-        float curscore, estscore;
 		int weight;
-        ushort route, prev;
         ushort links[MAXWAYPOINTLINKS];
 
         waypoint() {}
-        waypoint(const vec &o, int weight = 0) : o(o), weight(weight), route(0) { memset(links, 0, sizeof(links)); }
-
-        int score() const { return int(curscore) + int(estscore); }
+        waypoint(const vec &o, int weight = 0) : o(o), weight(weight) { memset(links, 0, sizeof(links)); }
 
         int find(int wp)
 		{
@@ -128,7 +124,10 @@ namespace ai
         int remap(fpsent *d, int n, vec &pos, bool retry = false);
     };
 
-    extern bool route(fpsent *d, int node, int goal, vector<int> &route, const avoidset &obstacles, int retries = 0);
+    struct routestate;
+    extern routestate *newroutestate();
+    extern void freeroutestate(routestate *&rs);
+    extern bool route(routestate &rs, fpsent *d, int node, int goal, vector<int> &route, const avoidset &obstacles, int retries = 0);
     extern void navigate();
     extern void clearwaypoints(bool full = false);
     extern void seedwaypoints();
@@ -188,11 +187,12 @@ namespace ai
         vector<int> route;
         vec target, spot;
         int enemy, enemyseen, enemymillis, weappref, prevnodes[NUMPREVNODES], targnode, targlast, targtime, targseq,
-            lastrun, lasthunt, lastaction, lastcheck, jumpseed, jumprand, blocktime, huntseq, blockseq, lastaimrnd;
+            lastrun, lasthunt, lastaction, lastcheck, jumpseed, jumprand, blocktime, huntseq, blockseq, lastaimrnd,
+            sightstart, numsights;
         float targyaw, targpitch, views[3], aimrnd[3];
         bool dontmove, becareful, tryreset, trywipe;
 
-        aiinfo()
+        aiinfo() : sightstart(0), numsights(0)
         {
             clearsetup();
             reset();
@@ -291,6 +291,7 @@ namespace ai
 
     extern void init(fpsent *d, int at, int on, int sk, int bn, int pm, const char *name, const char *team);
     extern void update();
+    extern void cleanup();
     extern void avoid();
     extern void think(fpsent *d, bool run);
 
@@ -2106,6 +2106,12 @@ namespace game
         }
     }
 
+    static void writtendemo(int id, const char *name, bool ok, uchar *&data, size_t len, void *arg)
+    {
+        if(ok) conoutf("received demo \"%s\"", name);
+        else conoutf(CON_ERROR, "could not write demo \"%s\"", name);
+    }
+
 	// accept file download from server
     void receivefile(packetbuf &p)
     {
@@ -2116,12 +2122,10 @@ namespace game
             case N_SENDDEMO:
             {
                 defformatstring(fname)("%d.dmo", lastmillis);
-                stream *demo = openrawfile(fname, "wb");
-                if(!demo) return;
-                conoutf("received demo \"%s\"", fname);
                 ucharbuf b = p.subbuf(p.remaining());
-                demo->write(b.buf, b.maxlen);
-                delete demo;
+                uchar *data = new uchar[b.maxlen];
+                memcpy(data, b.buf, b.maxlen);
+                asyncwritefile(fname, data, b.maxlen, writtendemo);
                 break;
             }
 
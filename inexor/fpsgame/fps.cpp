@@ -659,6 +659,12 @@ namespace game
         players.add(player1);
     }
 
+    /// free game data at exit that is not tied to a map or connection
+    void cleargame()
+    {
+        ai::cleanup();
+    }
+
     /// show game mode description text during map load
     VARP(showmodeinfo, 0, 1, 1);
 
@@ -727,6 +733,7 @@ namespace game
     {
         ai::savewaypoints();
         ai::clearwaypoints(true);
+        ai::cleanup();
 
         respawnent = -1; // so we don't respawn at an old spot
         if(!m_mp(gamemode)) spawnplayer(player1);
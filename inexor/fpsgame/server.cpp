@@ -374,12 +374,6 @@ namespace server
         }
     };
 
-    struct ban
-    {
-        int time, expire;
-        uint ip;
-    };
-
     namespace aiman
     {
         extern void removeai(clientinfo *ci);
@@ -411,17 +405,15 @@ namespace server
     stream *mapdata = NULL;
 
     vector<uint> allowedips;
-    vector<ban> bannedips;
+    ipmasktable bannedips;
 
     void addban(uint ip, int expire)
     {
         allowedips.removeobj(ip);
-        ban b;
-        b.time = totalmillis;
-        b.expire = totalmillis + expire;
+        ipmask b;
         b.ip = ip;
-        loopv(bannedips) if(bannedips[i].expire - b.expire > 0) { bannedips.insert(i, b); return; }
-        bannedips.add(b);
+        b.mask = 0xFFFFFFFF;
+        bannedips.add(b, totalmillis + expire);
     }
 
     vector<clientinfo *> connects, clients, bots;
@@ -622,6 +614,7 @@ namespace server
     VAR(maxdemos, 0, 5, 25);
     VAR(maxdemosize, 0, 16, 31);
     VAR(restrictdemos, 0, 1, 1);
+    VAR(demolevel, 0, 6, 9); // zlib level for recorded demos, lower levels cost less cpu per frame
 
     VAR(restrictpausegame, 0, 1, 1);
     VAR(restrictgamespeed, 0, 1, 1);
@@ -790,10 +783,20 @@ namespace server
         return false;
     }
 
+    /// read the entities and CRCs of all maps in the rotation on startup, so
+    /// map changes on a dedicated server are served from the map entity cache
+    VAR(precachemaps, 0, 1, 1);
+
     void serverinit()
     {
         smapname[0] = '\0';
         resetitems();
+        if(precachemaps && isdedicatedserver())
+        {
+            int cached = 0;
+            loopv(maprotations) if(maprotations[i].map[0] && precachemapents(maprotations[i].map)) cached++;
+            if(cached) logoutf("cached entities of %d maps", cached);
+        }
     }
 
     int numclients(int exclude = -1, bool nospec = true, bool noai = true, bool priv = false)
@@ -1117,7 +1120,7 @@ namespace server
         demotmp = opentempfile("demorecord", "w+b");
         if(!demotmp) return;
 
-        stream *f = opengzfile(NULL, "wb", demotmp);
+        stream *f = opengzfile(NULL, "wb", demotmp, demolevel);
         if(!f) { DELETEP(demotmp); return; }
 
         sendservmsg("recording demo");
@@ -1365,10 +1368,12 @@ namespace server
 
     void hashpassword(int cn, int sessionid, const char *pwd, char *result, int maxlen)
     {
-        char buf[2*sizeof(string)];
-        formatstring(buf)("%d %d ", cn, sessionid);
-        concatstring(buf, pwd, sizeof(buf));
-        if(!hashstring(buf, result, maxlen)) *result = '\0';
+        string prefix;
+        formatstring(prefix)("%d %d ", cn, sessionid);
+        void *h = newhash();
+        updatehash(h, prefix, strlen(prefix));
+        updatehash(h, pwd, strlen(pwd));
+        if(!finishhash(h, result, maxlen)) *result = '\0';
     }
 
     bool checkpassword(clientinfo *ci, const char *wanted, const char *given)
@@ -2506,7 +2511,7 @@ namespace server
         }
         else if(smode) smode->updatelimbo();
 
-        while(bannedips.length() && bannedips[0].expire-totalmillis <= 0) bannedips.remove(0);
+        bannedips.prune(totalmillis);
         loopv(connects) if(totalmillis-connects[i]->connectmillis>15000) disconnect_client(connects[i]->clientnum, DISC_TIMEOUT);
 
         if(nextexceeded && gamemillis > nextexceeded && (!m_timed || gamemillis < gamelimit))
@@ -2637,7 +2642,7 @@ namespace server
 
     void noclients()
     {
-        bannedips.shrink(0);
+        bannedips.clear();
         aiman::clearai();
     }
 
@@ -2694,17 +2699,16 @@ namespace server
 
     int reserveclients() { return 3; }
 
-    vector<ipmask> gbans;
+    ipmasktable gbans;
 
     void cleargbans()
     {
-        gbans.shrink(0);
+        gbans.clear();
     }
 
     bool checkgban(uint ip)
     {
-        loopv(gbans) if(gbans[i].check(ip)) return true;
-        return false;
+        return gbans.check(ip);
     }
 
     void addgban(const char *name)
@@ -2733,7 +2737,7 @@ namespace server
         if(adminpass[0] && checkpassword(ci, adminpass, pwd)) return DISC_NONE;
         if(numclients(-1, false, true)>=maxclients) return DISC_MAXCLIENTS;
         uint ip = getclientip(ci->clientnum);
-        loopv(bannedips) if(bannedips[i].ip==ip) return DISC_IPBAN;
+        if(bannedips.check(ip, totalmillis)) return DISC_IPBAN;
         if(checkgban(ip)) return DISC_IPBAN;
         if(mastermode>=MM_PRIVATE && allowedips.find(ip)<0) return DISC_PRIVATE;
         return DISC_NONE;
@@ -3438,7 +3442,7 @@ namespace server
             {
                 if(ci->privilege || ci->local)
                 {
-                    bannedips.shrink(0);
+                    bannedips.clear();
                     sendservmsg("cleared all bans");
                 }
                 break;
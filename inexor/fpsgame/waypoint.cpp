@@ -35,341 +35,120 @@ namespace ai
         return weight;
     }
 
-    enum
-    {
-        WPCACHE_STATIC = 0,
-        WPCACHE_DYNAMIC,
-        NUMWPCACHES
-    };
-
-    struct wpcache
-    {
-        struct node
-        {
-            float split[2];
-            uint child[2];
-
-            int axis() const { return child[0]>>30; }
-            int childindex(int which) const { return child[which]&0x3FFFFFFF; }
-            bool isleaf(int which) const { return (child[1]&(1<<(30+which)))!=0; }
-        };
-
-        vector<node> nodes;
-        int firstwp, lastwp;
-        vec bbmin, bbmax;
-
-        wpcache() { clear(); }
-
-        void clear()
-        {
-            nodes.setsize(0);
-            firstwp = lastwp = -1;
-            bbmin = vec(1e16f, 1e16f, 1e16f);
-            bbmax = vec(-1e16f, -1e16f, -1e16f);
-        }
-
-        void build(int first = 0, int last = -1)
-        {
-            if(last < 0) last = waypoints.length();
-            vector<int> indices;
-            for(int i = first; i < last; i++)
-            {
-                waypoint &w = waypoints[i];
-                indices.add(i);
-                if(firstwp < 0) firstwp = i;
-                float radius = WAYPOINTRADIUS;
-                bbmin.min(vec(w.o).sub(radius));
-                bbmax.max(vec(w.o).add(radius));
-            }
-            if(first < last) lastwp = max(lastwp, last-1);
-            if(indices.length())
-            {
-                nodes.reserve(indices.length());
-                build(indices.getbuf(), indices.length(), bbmin, bbmax);
-            }
-        }
-
-        void build(int *indices, int numindices, const vec &vmin, const vec &vmax)
-        {
-            int axis = 2;
-            loopk(2) if(vmax[k] - vmin[k] > vmax[axis] - vmin[axis]) axis = k;
+    static int waypointversion = 0; ///< bumped whenever waypoints or their links change
 
-            vec leftmin(1e16f, 1e16f, 1e16f), leftmax(-1e16f, -1e16f, -1e16f), rightmin(1e16f, 1e16f, 1e16f), rightmax(-1e16f, -1e16f, -1e16f);
-            float split = 0.5f*(vmax[axis] + vmin[axis]), splitleft = -1e16f, splitright = 1e16f;
-            int left, right;
-            for(left = 0, right = numindices; left < right;)
-            {
-                waypoint &w = waypoints[indices[left]];
-                float radius = WAYPOINTRADIUS;
-                if(max(split - (w.o[axis]-radius), 0.0f) > max((w.o[axis]+radius) - split, 0.0f))
-                {
-                    ++left;
-                    splitleft = max(splitleft, w.o[axis]+radius);
-                    leftmin.min(vec(w.o).sub(radius));
-                    leftmax.max(vec(w.o).add(radius));
-                }
-                else
-                {
-                    --right;
-                    swap(indices[left], indices[right]);
-                    splitright = min(splitright, w.o[axis]-radius);
-                    rightmin.min(vec(w.o).sub(radius));
-                    rightmax.max(vec(w.o).add(radius));
-                }
-            }
-
-            if(!left || right==numindices)
-            {
-                leftmin = rightmin = vec(1e16f, 1e16f, 1e16f);
-                leftmax = rightmax = vec(-1e16f, -1e16f, -1e16f);
-                left = right = numindices/2;
-                splitleft = -1e16f;
-                splitright = 1e16f;
-                loopi(numindices)
-                {
-                    waypoint &w = waypoints[indices[i]];
-                    float radius = WAYPOINTRADIUS;
-                    if(i < left)
-                    {
-                        splitleft = max(splitleft, w.o[axis]+radius);
-                        leftmin.min(vec(w.o).sub(radius));
-                        leftmax.max(vec(w.o).add(radius));
-                    }
-                    else
-                    {
-                        splitright = min(splitright, w.o[axis]-radius);
-                        rightmin.min(vec(w.o).sub(radius));
-                        rightmax.max(vec(w.o).add(radius));
-                    }
-                }
-            }
+    static inline void changedwaypoints() { waypointversion++; }
 
-            int offset = nodes.length();
-            node &curnode = nodes.add();
-            curnode.split[0] = splitleft;
-            curnode.split[1] = splitright;
+    /// waypoints are bucketed into vertical columns of a hash grid; new waypoints are simply appended to
+    /// their column, so bots inferring waypoints never cause the index to be rebuilt
+    #define WPGRID_SHIFT 7
 
-            if(left<=1) curnode.child[0] = (axis<<30) | (left>0 ? indices[0] : 0x3FFFFFFF);
-            else
-            {
-                curnode.child[0] = (axis<<30) | (nodes.length()-offset);
-                if(left) build(indices, left, leftmin, leftmax);
-            }
+    static hashtable<int, vector<int> > wpgrid;
+    static int wpgridindexed = 0, wpgridmin[2] = { 0xFFFF, 0xFFFF }, wpgridmax[2] = { -1, -1 };
 
-            if(numindices-right<=1) curnode.child[1] = (1<<31) | (left<=1 ? 1<<30 : 0) | (numindices-right>0 ? indices[right] : 0x3FFFFFFF);
-            else
-            {
-                curnode.child[1] = (left<=1 ? 1<<30 : 0) | (nodes.length()-offset);
-                if(numindices-right) build(&indices[right], numindices-right, rightmin, rightmax);
-            }
-        }
-    } wpcaches[NUMWPCACHES];
+    static inline int wpgridcoord(float c) { return clamp(int(c), 0, 0xFFFF) >> WPGRID_SHIFT; }
+    static inline int wpgridkey(int x, int y) { return x | (y << 16); }
 
-    static int invalidatedwpcaches = 0, clearedwpcaches = (1<<NUMWPCACHES)-1, numinvalidatewpcaches = 0, lastwpcache = 0;
+    avoidset wpavoid;
 
-    static inline void invalidatewpcache(int wp)
+    void clearwpcache()
     {
-        if(++numinvalidatewpcaches >= 1000) { numinvalidatewpcaches = 0; invalidatedwpcaches = (1<<NUMWPCACHES)-1; }
-        else
-        {
-            loopi(WPCACHE_DYNAMIC) if(wp >= wpcaches[i].firstwp && wp <= wpcaches[i].lastwp) { invalidatedwpcaches |= 1<<i; return; }
-            invalidatedwpcaches |= 1<<WPCACHE_DYNAMIC;
-        }
+        changedwaypoints();
+        wpgrid.clear();
+        wpgridindexed = 0;
+        loopk(2) { wpgridmin[k] = 0xFFFF; wpgridmax[k] = -1; }
+        wpavoid.clear();
     }
-
-    void clearwpcache(bool full = true)
-    {
-        loopi(NUMWPCACHES) if(full || invalidatedwpcaches&(1<<i)) { wpcaches[i].clear(); clearedwpcaches |= 1<<i; }
-        if(full || invalidatedwpcaches == (1<<NUMWPCACHES)-1)
-	      {
-            numinvalidatewpcaches = 0;
-            lastwpcache = 0;
-        }
-        invalidatedwpcaches = 0;
-	  }
     ICOMMAND(clearwpcache, "", (), clearwpcache());
 
-    avoidset wpavoid;
-
-    void buildwpcache()
+    #define loopwpgrid(pos, radius, body) do { \
+        int x1 = max(wpgridcoord((pos).x - (radius)), wpgridmin[0]), x2 = min(wpgridcoord((pos).x + (radius)), wpgridmax[0]), \
+            y1 = max(wpgridcoord((pos).y - (radius)), wpgridmin[1]), y2 = min(wpgridcoord((pos).y + (radius)), wpgridmax[1]); \
+        if(x1 > x2 || y1 > y2) break; \
+        if((x2-x1+1)*(y2-y1+1) > wpgrid.numelems) \
+        { \
+            enumerate(wpgrid, vector<int>, cell, { loopvk(cell) { int n = cell[k]; body; } }); \
+        } \
+        else for(int cy = y1; cy <= y2; cy++) for(int cx = x1; cx <= x2; cx++) \
+        { \
+            vector<int> *cell = wpgrid.access(wpgridkey(cx, cy)); \
+            if(cell) loopvk(*cell) { int n = (*cell)[k]; body; } \
+        } \
+    } while(0)
+
+    /// indexes waypoints added since the last query
+    void updatewpcache()
     {
-        loopi(NUMWPCACHES) if(wpcaches[i].firstwp < 0)
-            wpcaches[i].build(i > 0 ? wpcaches[i-1].lastwp+1 : 1, i+1 >= NUMWPCACHES || wpcaches[i+1].firstwp < 0 ? -1 : wpcaches[i+1].firstwp);
-        clearedwpcaches = 0;
-        lastwpcache = waypoints.length();
+        if(wpgridindexed >= waypoints.length()) return;
+        int first = max(wpgridindexed, 1);
+        for(int i = first; i < waypoints.length(); i++)
+        {
+            const vec &o = waypoints[i].o;
+            int x = wpgridcoord(o.x), y = wpgridcoord(o.y);
+            wpgrid[wpgridkey(x, y)].add(i);
+            wpgridmin[0] = min(wpgridmin[0], x); wpgridmax[0] = max(wpgridmax[0], x);
+            wpgridmin[1] = min(wpgridmin[1], y); wpgridmax[1] = max(wpgridmax[1], y);
+        }
+        wpgridindexed = waypoints.length();
 
-		    wpavoid.clear();
-		    loopv(waypoints) if(waypoints[i].weight < 0) wpavoid.avoidnear(NULL, waypoints[i].o.z + WAYPOINTRADIUS, waypoints[i].o, WAYPOINTRADIUS);
+        // waypoints near ones that should be avoided are avoided too
+        float limit2 = WAYPOINTRADIUS*WAYPOINTRADIUS;
+        for(int wp = first; wp < waypoints.length(); wp++)
+        {
+            const waypoint &w = waypoints[wp];
+            if(w.weight < 0) { wpavoid.avoidnear(NULL, w.o.z + WAYPOINTRADIUS, w.o, WAYPOINTRADIUS); continue; }
+            if(first <= 1) continue;
+            float above = -1;
+            loopwpgrid(w.o, WAYPOINTRADIUS,
+            {
+                const waypoint &a = waypoints[n];
+                if(n < first && a.weight < 0 && a.o.squaredist(w.o) < limit2) above = a.o.z + WAYPOINTRADIUS;
+            });
+            if(above >= 0) wpavoid.add(NULL, above, wp);
+        }
     }
 
-    struct wpcachestack
-    {
-        wpcache::node *node;
-        float tmin, tmax;
-    };
-
-    vector<wpcache::node *> wpcachestack;
-
     int closestwaypoint(const vec &pos, float mindist, bool links, fpsent *d)
     {
         if(waypoints.empty()) return -1;
-        if(clearedwpcaches) buildwpcache();
-
-        #define CHECKCLOSEST(index) do { \
-            int n = (index); \
-            if(n < waypoints.length()) \
-            { \
-                const waypoint &w = waypoints[n]; \
-                if(!links || w.links[0]) \
-                { \
-                    float dist = w.o.squaredist(pos); \
-                    if(dist < mindist*mindist) { closest = n; mindist = sqrtf(dist); } \
-                } \
-            } \
-        } while(0)
+        updatewpcache();
+
         int closest = -1;
-        wpcache::node *curnode;
-        loop(which, NUMWPCACHES) if(wpcaches[which].firstwp >= 0) for(curnode = &wpcaches[which].nodes[0], wpcachestack.setsize(0);;)
+        loopwpgrid(pos, mindist,
         {
-            int axis = curnode->axis();
-            float dist1 = pos[axis] - curnode->split[0], dist2 = curnode->split[1] - pos[axis];
-            if(dist1 >= mindist)
+            const waypoint &w = waypoints[n];
+            if(!links || w.links[0])
             {
-                if(dist2 < mindist)
-                {
-                    if(!curnode->isleaf(1)) { curnode += curnode->childindex(1); continue; }
-                    CHECKCLOSEST(curnode->childindex(1));
-                }
+                float dist = w.o.squaredist(pos);
+                if(dist < mindist*mindist) { closest = n; mindist = sqrtf(dist); }
             }
-            else if(curnode->isleaf(0))
-            {
-                CHECKCLOSEST(curnode->childindex(0));
-                if(dist2 < mindist)
-                {
-                    if(!curnode->isleaf(1)) { curnode += curnode->childindex(1); continue; }
-                    CHECKCLOSEST(curnode->childindex(1));
-                }
-            }
-            else
-            {
-                if(dist2 < mindist)
-                {
-                    if(!curnode->isleaf(1)) wpcachestack.add(curnode + curnode->childindex(1));
-                    else CHECKCLOSEST(curnode->childindex(1));
-                }
-                curnode += curnode->childindex(0);
-                continue;
-            }
-            if(wpcachestack.empty()) break;
-            curnode = wpcachestack.pop();
-        }
-        for(int i = lastwpcache; i < waypoints.length(); i++) { CHECKCLOSEST(i); }
+        });
         return closest;
     }
 
     void findwaypointswithin(const vec &pos, float mindist, float maxdist, vector<int> &results)
     {
         if(waypoints.empty()) return;
-        if(clearedwpcaches) buildwpcache();
+        updatewpcache();
 
         float mindist2 = mindist*mindist, maxdist2 = maxdist*maxdist;
-        #define CHECKWITHIN(index) do { \
-            int n = (index); \
-            if(n < waypoints.length()) \
-            { \
-                const waypoint &w = waypoints[n]; \
-                float dist = w.o.squaredist(pos); \
-                if(dist > mindist2 && dist < maxdist2) results.add(n); \
-            } \
-        } while(0)
-        wpcache::node *curnode;
-        loop(which, NUMWPCACHES) if(wpcaches[which].firstwp >= 0) for(curnode = &wpcaches[which].nodes[0], wpcachestack.setsize(0);;)
-        {
-            int axis = curnode->axis();
-            float dist1 = pos[axis] - curnode->split[0], dist2 = curnode->split[1] - pos[axis];
-            if(dist1 >= maxdist)
-            {
-                if(dist2 < maxdist)
-                {
-                    if(!curnode->isleaf(1)) { curnode += curnode->childindex(1); continue; }
-                    CHECKWITHIN(curnode->childindex(1));
-                }
-            }
-            else if(curnode->isleaf(0))
-            {
-                CHECKWITHIN(curnode->childindex(0));
-                if(dist2 < maxdist)
-                {
-                    if(!curnode->isleaf(1)) { curnode += curnode->childindex(1); continue; }
-                    CHECKWITHIN(curnode->childindex(1));
-                }
-            }
-            else
-            {
-                if(dist2 < maxdist)
-                {
-                    if(!curnode->isleaf(1)) wpcachestack.add(curnode + curnode->childindex(1));
-                    else CHECKWITHIN(curnode->childindex(1));
-                }
-                curnode += curnode->childindex(0);
-                continue;
-            }
-            if(wpcachestack.empty()) break;
-            curnode = wpcachestack.pop();
-        }
-        for(int i = lastwpcache; i < waypoints.length(); i++) { CHECKWITHIN(i); }
+        loopwpgrid(pos, maxdist,
+        {
+            float dist = waypoints[n].o.squaredist(pos);
+            if(dist > mindist2 && dist < maxdist2) results.add(n);
+        });
     }
 
     void avoidset::avoidnear(void *owner, float above, const vec &pos, float limit)
     {
         if(ai::waypoints.empty()) return;
-        if(clearedwpcaches) buildwpcache();
+        updatewpcache();
 
         float limit2 = limit*limit;
-        #define CHECKNEAR(index) do { \
-            int n = (index); \
-            if(n < ai::waypoints.length()) \
-            { \
-                const waypoint &w = ai::waypoints[n]; \
-                if(w.o.squaredist(pos) < limit2) add(owner, above, n); \
-            } \
-        } while(0)
-        wpcache::node *curnode;
-        loop(which, NUMWPCACHES) if(wpcaches[which].firstwp >= 0) for(curnode = &wpcaches[which].nodes[0], wpcachestack.setsize(0);;)
-        {
-            int axis = curnode->axis();
-            float dist1 = pos[axis] - curnode->split[0], dist2 = curnode->split[1] - pos[axis];
-            if(dist1 >= limit)
-            {
-                if(dist2 < limit)
-                {
-                    if(!curnode->isleaf(1)) { curnode += curnode->childindex(1); continue; }
-                    CHECKNEAR(curnode->childindex(1));
-                }
-            }
-            else if(curnode->isleaf(0))
-            {
-                CHECKNEAR(curnode->childindex(0));
-                if(dist2 < limit)
-                {
-                    if(!curnode->isleaf(1)) { curnode += curnode->childindex(1); continue; }
-                    CHECKNEAR(curnode->childindex(1));
-                }
-            }
-            else
-            {
-                if(dist2 < limit)
-                {
-                    if(!curnode->isleaf(1)) wpcachestack.add(curnode + curnode->childindex(1));
-                    else CHECKNEAR(curnode->childindex(1));
-                }
-                curnode += curnode->childindex(0);
-                continue;
-            }
-            if(wpcachestack.empty()) break;
-            curnode = wpcachestack.pop();
-        }
-        for(int i = lastwpcache; i < waypoints.length(); i++) { CHECKNEAR(i); }
+        loopwpgrid(pos, limit,
+        {
+            if(ai::waypoints[n].o.squaredist(pos) < limit2) add(owner, above, n);
+        });
     }
 
     int avoidset::remap(fpsent *d, int n, vec &pos, bool retry)
@@ -420,57 +199,127 @@ namespace ai
         return n;
     }
 
-    static inline float heapscore(waypoint *q) { return q->score(); }
-
-    bool route(fpsent *d, int node, int goal, vector<int> &route, const avoidset &obstacles, int retries)
+    /// search state of one route query, kept apart from the waypoints so queries do not share it
+    struct routestate
     {
-        if(waypoints.empty() || !iswaypoint(node) || !iswaypoint(goal) || goal == node || !waypoints[node].links[0])
-            return false;
+        struct node
+        {
+            float curscore, estscore;
+            int heappos;
+            ushort route, prev;
+
+            int score() const { return int(curscore) + int(estscore); }
+        };
+
+        vector<node> nodes;
+        vector<int> heap; ///< open waypoints, ordered by score; nodes[wp].heappos indexes into it
+        ushort routeid;
 
-        static ushort routeid = 1;
-        static vector<waypoint *> queue;
+        routestate() : routeid(1) {}
 
-        if(!routeid)
+        void begin()
         {
-            loopv(waypoints) waypoints[i].route = 0;
-            routeid = 1;
+            if(!routeid)
+            {
+                loopv(nodes) nodes[i].route = 0;
+                routeid = 1;
+            }
+            while(nodes.length() < waypoints.length()) nodes.add().route = 0;
+            heap.setsize(0);
         }
 
-        if(d)
+        void mark(int wp, float curscore, float estscore)
         {
-            if(retries <= 1 && d->ai) loopi(ai::NUMPREVNODES) if(d->ai->prevnodes[i] != node && iswaypoint(d->ai->prevnodes[i]))
+            node &n = nodes[wp];
+            n.route = routeid;
+            n.curscore = curscore;
+            n.estscore = estscore;
+        }
+
+        bool visited(int wp) const { return nodes[wp].route == routeid; }
+
+        void place(int i, int wp) { heap[i] = wp; nodes[wp].heappos = i; }
+
+        void upheap(int i)
+        {
+            int wp = heap[i], score = nodes[wp].score();
+            while(i > 0)
+            {
+                int pi = (i - 1) >> 1;
+                if(score >= nodes[heap[pi]].score()) break;
+                place(i, heap[pi]);
+                i = pi;
+            }
+            place(i, wp);
+        }
+
+        void downheap(int i)
+        {
+            int wp = heap[i], score = nodes[wp].score();
+            for(;;)
             {
-                waypoints[d->ai->prevnodes[i]].route = routeid;
-                waypoints[d->ai->prevnodes[i]].curscore = -1;
-                waypoints[d->ai->prevnodes[i]].estscore = 0;
+                int ci = (i << 1) + 1;
+                if(ci >= heap.length()) break;
+                int cscore = nodes[heap[ci]].score();
+                if(score > cscore)
+                {
+                    if(ci+1 < heap.length() && nodes[heap[ci+1]].score() < cscore) ci++;
+                }
+                else if(ci+1 < heap.length() && nodes[heap[ci+1]].score() < score) ci++;
+                else break;
+                place(i, heap[ci]);
+                i = ci;
             }
+            place(i, wp);
+        }
+
+        void push(int wp)
+        {
+            heap.add(wp);
+            upheap(heap.length()-1);
+        }
+
+        int pop()
+        {
+            int wp = heap[0], last = heap.pop();
+            if(heap.length()) { place(0, last); downheap(0); }
+            return wp;
+        }
+
+        /// lowers the score of a waypoint that is still open
+        void update(int wp) { upheap(nodes[wp].heappos); }
+    };
+
+    bool findroute(routestate &rs, fpsent *d, int node, int goal, vector<int> &route, const avoidset &obstacles, int retries)
+    {
+        rs.begin();
+
+        if(d)
+        {
+            if(retries <= 1 && d->ai) loopi(ai::NUMPREVNODES) if(d->ai->prevnodes[i] != node && iswaypoint(d->ai->prevnodes[i]))
+                rs.mark(d->ai->prevnodes[i], -1, 0);
 			if(retries <= 0)
 			{
             loopavoid(obstacles, d,
             {
 					if(iswaypoint(wp) && wp != node && wp != goal && waypoints[node].find(wp) < 0 && waypoints[goal].find(wp) < 0)
-                {
-                    waypoints[wp].route = routeid;
-                    waypoints[wp].curscore = -1;
-                    waypoints[wp].estscore = 0;
-                }
+                    rs.mark(wp, -1, 0);
             });
         }
         }
 
-        waypoints[node].route = routeid;
-        waypoints[node].curscore = waypoints[node].estscore = 0;
-        waypoints[node].prev = 0;
-        queue.setsize(0);
-        queue.add(&waypoints[node]);
+        rs.mark(node, 0, 0);
+        rs.nodes[node].prev = 0;
+        rs.push(node);
         route.setsize(0);
 
         int lowest = -1;
-        while(!queue.empty())
+        while(!rs.heap.empty())
         {
-            waypoint &m = *queue.removeheap();
-            float prevscore = m.curscore;
-            m.curscore = -1;
+            int cur = rs.pop();
+            waypoint &m = waypoints[cur];
+            float prevscore = rs.nodes[cur].curscore;
+            rs.nodes[cur].curscore = -1;
             loopi(MAXWAYPOINTLINKS)
             {
                 int link = m.links[i];
@@ -478,37 +327,115 @@ namespace ai
                 if(iswaypoint(link) && (link == node || link == goal || waypoints[link].links[0]))
                 {
                     waypoint &n = waypoints[link];
+                    routestate::node &rn = rs.nodes[link];
                     int weight = max(n.weight, 1);
                     float curscore = prevscore + n.o.dist(m.o)*weight;
-                    if(n.route == routeid && curscore >= n.curscore) continue;
-                    n.curscore = curscore;
-                    n.prev = ushort(&m - &waypoints[0]);
-                    if(n.route != routeid)
+                    if(rs.visited(link) && curscore >= rn.curscore) continue;
+                    rn.curscore = curscore;
+                    rn.prev = ushort(cur);
+                    if(!rs.visited(link))
                     {
-                        n.estscore = n.o.dist(waypoints[goal].o)*weight;
-                        if(n.estscore <= WAYPOINTRADIUS*4 && (lowest < 0 || n.estscore <= waypoints[lowest].estscore))
+                        rn.estscore = n.o.dist(waypoints[goal].o)*weight;
+                        if(rn.estscore <= WAYPOINTRADIUS*4 && (lowest < 0 || rn.estscore <= rs.nodes[lowest].estscore))
                             lowest = link;
-                        n.route = routeid;
+                        rn.route = rs.routeid;
                         if(link == goal) goto foundgoal;
-                        queue.addheap(&n);
+                        rs.push(link);
                     }
-                    else loopvj(queue) if(queue[j] == &n) { queue.upheap(j); break; }
+                    else rs.update(link);
                 }
             }
         }
         foundgoal:
 
-        routeid++;
+        rs.routeid++;
 
         if(lowest >= 0) // otherwise nothing got there
         {
-            for(waypoint *m = &waypoints[lowest]; m > &waypoints[0]; m = &waypoints[m->prev])
-                route.add(m - &waypoints[0]); // just keep it stored backward
+            for(int m = lowest; m > 0; m = rs.nodes[m].prev)
+                route.add(m); // just keep it stored backward
         }
 
         return !route.empty();
     }
 
+    /// routes that ignore prevnodes and obstacles only depend on the waypoint graph, so they are kept
+    /// until waypoints change; this mostly spares bots from searching the whole graph again and again
+    /// for goals they cannot reach
+    struct routekey
+    {
+        int node, goal;
+    };
+
+    static inline uint hthash(const routekey &k) { return uint(k.node) ^ (uint(k.goal) << 16); }
+    static inline bool htcmp(const routekey &x, const routekey &y) { return x.node == y.node && x.goal == y.goal; }
+
+    static hashtable<routekey, vector<int> > routecache;
+    static int routecacheversion = -1;
+    static SDL_mutex *routecachelock = NULL;
+    VAR(maxcachedroutes, 0, 1024, 65536);
+
+    routestate *newroutestate()
+    {
+        // created here, before any thread routes, so the lock itself needs no guarding
+        if(!routecachelock) routecachelock = SDL_CreateMutex();
+        return new routestate;
+    }
+
+    void freeroutestate(routestate *&rs)
+    {
+        DELETEP(rs);
+    }
+
+    /// copies the cached route into route, or returns false if there is none
+    static bool findcachedroute(const routekey &key, vector<int> &route)
+    {
+        SDL_LockMutex(routecachelock);
+        if(routecacheversion != waypointversion)
+        {
+            routecache.clear();
+            routecacheversion = waypointversion;
+        }
+        vector<int> *cached = routecache.access(key);
+        if(cached)
+        {
+            route.setsize(0);
+            route.put(cached->getbuf(), cached->length());
+        }
+        SDL_UnlockMutex(routecachelock);
+        return cached != NULL;
+    }
+
+    static void cacheroute(const routekey &key, const vector<int> &route)
+    {
+        SDL_LockMutex(routecachelock);
+        if(routecacheversion != waypointversion || routecache.numelems >= maxcachedroutes)
+        {
+            routecache.clear();
+            routecacheversion = waypointversion;
+        }
+        vector<int> &cached = routecache[key];
+        cached.setsize(0);
+        cached.put(route.getbuf(), route.length());
+        SDL_UnlockMutex(routecachelock);
+    }
+
+    /// rs is the caller's scratch space, so threads that each bring their own can route at the same time
+    bool route(routestate &rs, fpsent *d, int node, int goal, vector<int> &route, const avoidset &obstacles, int retries)
+    {
+        if(waypoints.empty() || !iswaypoint(node) || !iswaypoint(goal) || goal == node || !waypoints[node].links[0])
+            return false;
+
+        bool constrained = d && (retries <= 0 || (retries <= 1 && d->ai));
+        if(constrained || !maxcachedroutes || !routecachelock) return findroute(rs, d, node, goal, route, obstacles, retries);
+
+        routekey key = { node, goal };
+        if(findcachedroute(key, route)) return !route.empty();
+        findroute(rs, d, node, goal, route, obstacles, retries);
+        cacheroute(key, route);
+        return !route.empty();
+    }
+
     VARF(dropwaypoints, 0, 0, 1, { player1->lastnode = -1; });
 
     int addwaypoint(const vec &o, int weight = -1)
@@ -516,7 +443,7 @@ namespace ai
         if(waypoints.length() > MAXWAYPOINTS) return -1;
         int n = waypoints.length();
         waypoints.add(waypoint(o, weight >= 0 ? weight : getweight(o)));
-        invalidatewpcache(n);
+        changedwaypoints();
         return n;
     }
 
@@ -525,9 +452,10 @@ namespace ai
         loopi(MAXWAYPOINTLINKS)
         {
             if(a.links[i] == n) return;
-            if(!a.links[i]) { a.links[i] = n; return; }
+            if(!a.links[i]) { a.links[i] = n; changedwaypoints(); return; }
         }
         a.links[rnd(MAXWAYPOINTLINKS)] = n;
+        changedwaypoints();
     }
 
     string loadedwaypoints = "";
@@ -596,7 +524,6 @@ namespace ai
     void navigate()
     {
     	if(shouldnavigate()) loopv(players) ai::navigate(players[i]);
-        if(invalidatedwpcaches) clearwpcache(false);
     }
 
     void clearwaypoints(bool full)
@@ -101,71 +101,128 @@ namespace tiger
         }
     }
 
-    void hash(const uchar *str, int length, hashval &val)
+    /// builds the sboxes on first use; the function local static makes this safe to race on,
+    /// as challenges are generated on the master's worker threads as well as inline
+    void init()
     {
-        static bool init = false;
-        if(!init) { gensboxes(); init = true; }
+        static const bool initialized = (gensboxes(), true);
+        (void)initialized;
+    }
 
-        uchar temp[64];
+    /// incremental hashing: feed data in pieces of any size as it arrives, e.g. while reading a stream
+    struct hasher
+    {
+        chunk state[3];
+        uchar buf[64];
+        int buflen;
+        chunk length;
 
-        val.chunks[0] = 0x0123456789ABCDEFULL;
-        val.chunks[1] = 0xFEDCBA9876543210ULL;
-        val.chunks[2] = 0xF096A5B4C3B2E187ULL;
+        hasher() { reset(); }
+
+        void reset()
+        {
+            init();
+            state[0] = 0x0123456789ABCDEFULL;
+            state[1] = 0xFEDCBA9876543210ULL;
+            state[2] = 0xF096A5B4C3B2E187ULL;
+            buflen = 0;
+            length = 0;
+        }
 
-        int i = length;
-        for(; i >= 64; i -= 64, str += 64)
+        void block(const uchar *str)
         {
             if(!*(const uchar *)&islittleendian)
             {
+                uchar temp[64];
                 loopj(64) temp[j^7] = str[j];
-                compress((chunk *)temp, val.chunks);
+                compress((chunk *)temp, state);
             }
-            else compress((chunk *)str, val.chunks);
+            else compress((const chunk *)str, state);
         }
 
-        int j;
-        if(!*(const uchar *)&islittleendian)
+        void update(const uchar *str, int len)
         {
-            for(j = 0; j < i; j++) temp[j^7] = str[j];
-            temp[j^7] = 0x01;
-            while(++j&7) temp[j^7] = 0;
-        }
-        else
-        {
-            for(j = 0; j < i; j++) temp[j] = str[j];
-            temp[j] = 0x01;
-            while(++j&7) temp[j] = 0;
+            length += len;
+            if(buflen)
+            {
+                int n = min(64 - buflen, len);
+                memcpy(&buf[buflen], str, n);
+                buflen += n;
+                str += n;
+                len -= n;
+                if(buflen < 64) return;
+                block(buf);
+                buflen = 0;
+            }
+            for(; len >= 64; len -= 64, str += 64) block(str);
+            memcpy(buf, str, len);
+            buflen = len;
         }
 
-        if(j > 56)
-        {
-            while(j < 64) temp[j++] = 0;
-            compress((chunk *)temp, val.chunks);
-            j = 0;
-        }
-        while(j < 56) temp[j++] = 0;
-        *(chunk *)(temp+56) = (chunk)length<<3;
-        compress((chunk *)temp, val.chunks);
-        if(!*(const uchar *)&islittleendian)
+        void finish(hashval &val)
         {
-            loopk(3) 
+            uchar temp[64];
+            int i = buflen, j;
+            if(!*(const uchar *)&islittleendian)
+            {
+                for(j = 0; j < i; j++) temp[j^7] = buf[j];
+                temp[j^7] = 0x01;
+                while(++j&7) temp[j^7] = 0;
+            }
+            else
+            {
+                for(j = 0; j < i; j++) temp[j] = buf[j];
+                temp[j] = 0x01;
+                while(++j&7) temp[j] = 0;
+            }
+
+            if(j > 56)
             {
-                uchar *c = &val.bytes[k*sizeof(chunk)];
-                loopl(sizeof(chunk)/2) swap(c[l], c[sizeof(chunk)-1-l]);
+                while(j < 64) temp[j++] = 0;
+                compress((chunk *)temp, state);
+                j = 0;
+            }
+            while(j < 56) temp[j++] = 0;
+            *(chunk *)(temp+56) = length<<3;
+            compress((chunk *)temp, state);
+            memcpy(val.chunks, state, sizeof(val.chunks));
+            if(!*(const uchar *)&islittleendian)
+            {
+                loopk(3) 
+                {
+                    uchar *c = &val.bytes[k*sizeof(chunk)];
+                    loopl(sizeof(chunk)/2) swap(c[l], c[sizeof(chunk)-1-l]);
+                }
             }
         }
+    };
+
+    void hash(const uchar *str, int length, hashval &val)
+    {
+        hasher h;
+        h.update(str, length);
+        h.finish(val);
     }
 }
 
 /* Elliptic curve cryptography based on NIST DSS prime curves. */
 
-#define BI_DIGIT_BITS 16
-#define BI_DIGIT_MASK ((1<<BI_DIGIT_BITS)-1)
+/* Digits are machine words where the compiler offers a double width product (__int128 on 64 bit
+ * gcc/clang, which also lets it emit mulx), and 32 bit words otherwise. */
+#ifdef __SIZEOF_INT128__
+#define BI_DIGIT_BITS 64
+typedef unsigned long long bidigit;
+typedef unsigned __int128 bidbldigit;
+#else
+#define BI_DIGIT_BITS 32
+typedef uint bidigit;
+typedef unsigned long long bidbldigit;
+#endif
 
 template<int BI_DIGITS> struct bigint
 {
-    typedef ushort digit;
-    typedef uint dbldigit;
+    typedef bidigit digit;
+    typedef bidbldigit dbldigit;
 
     int len;
     digit digits[BI_DIGITS];
@@ -175,20 +232,20 @@ template<int BI_DIGITS> struct bigint
     bigint(const char *s) { parse(s); }
     template<int Y_DIGITS> bigint(const bigint<Y_DIGITS> &y) { *this = y; }
 
-    static int parsedigits(ushort *digits, int maxlen, const char *s)
+    static int parsedigits(digit *digits, int maxlen, const char *s)
     {
         int slen = 0;
         while(isxdigit(s[slen])) slen++;
-        int len = (slen+2*sizeof(ushort)-1)/(2*sizeof(ushort));
+        int len = (slen+2*sizeof(digit)-1)/(2*sizeof(digit));
         if(len>maxlen) return 0;
-        memset(digits, 0, len*sizeof(ushort));
+        memset(digits, 0, len*sizeof(digit));
         loopi(slen)
         {
             int c = s[slen-i-1];
             if(isalpha(c)) c = toupper(c) - 'A' + 10;
             else if(isdigit(c)) c -= '0';
             else return 0;
-            digits[i/(2*sizeof(ushort))] |= c<<(4*(i%(2*sizeof(ushort))));
+            digits[i/(2*sizeof(digit))] |= digit(c)<<(4*(i%(2*sizeof(digit))));
         }
         return len;
     }
@@ -237,7 +294,7 @@ template<int BI_DIGITS> struct bigint
     {
         if(!len) return 0;
         int bits = len*BI_DIGIT_BITS;
-        digit last = digits[len-1], mask = 1<<(BI_DIGIT_BITS-1);
+        digit last = digits[len-1], mask = digit(1)<<(BI_DIGIT_BITS-1);
         while(mask)
         {
             if(last&mask) return bits;
@@ -274,7 +331,7 @@ template<int BI_DIGITS> struct bigint
         int i;
         for(i = 0; i < y.len || borrow; i++)
         {
-             borrow = (1<<BI_DIGIT_BITS) + (dbldigit)x.digits[i] - (i<y.len ? (dbldigit)y.digits[i] : 0) - borrow;
+             borrow = (dbldigit(1)<<BI_DIGIT_BITS) + (dbldigit)x.digits[i] - (i<y.len ? (dbldigit)y.digits[i] : 0) - borrow;
              digits[i] = (digit)borrow;
              borrow = (borrow>>BI_DIGIT_BITS)^1;
         }
@@ -313,7 +370,7 @@ template<int BI_DIGITS> struct bigint
                 digits[i+j] = (digit)carry;
                 carry >>= BI_DIGIT_BITS;
             }
-            digits[i+y.len] = carry;
+            digits[i+y.len] = (digit)carry;
         }
         len = x.len + y.len;
         shrink();
@@ -324,17 +381,15 @@ template<int BI_DIGITS> struct bigint
     {
         if(!len || n<=0) return *this;
         if(n >= len*BI_DIGIT_BITS) { len = 0; return *this; }
-        int dig = (n-1)/BI_DIGIT_BITS;
-        n = ((n-1) % BI_DIGIT_BITS)+1;
-        digit carry = digit(digits[dig]>>n);
-        for(int i = dig+1; i < len; i++)
+        int dig = n/BI_DIGIT_BITS;
+        n %= BI_DIGIT_BITS;
+        if(!n) memmove(digits, &digits[dig], (len-dig)*sizeof(digit));
+        else
         {
-            digit tmp = digits[i];
-            digits[i-dig-1] = digit((tmp<<(BI_DIGIT_BITS-n)) | carry);
-            carry = digit(tmp>>n);
+            for(int i = dig; i < len-1; i++) digits[i-dig] = (digits[i]>>n) | (digits[i+1]<<(BI_DIGIT_BITS-n));
+            digits[len-1-dig] = digits[len-1]>>n;
         }
-        digits[len-dig-1] = carry;
-        len -= dig + (n/BI_DIGIT_BITS);
+        len -= dig;
         shrink();
         return *this;
     }
@@ -344,19 +399,35 @@ template<int BI_DIGITS> struct bigint
         if(!len || n<=0) return *this;
         int dig = n/BI_DIGIT_BITS;
         n %= BI_DIGIT_BITS;
-        digit carry = 0;
-        loopirev(len)
+        if(!n) memmove(&digits[dig], digits, len*sizeof(digit));
+        else
         {
-            digit tmp = digits[i];
-            digits[i+dig] = digit((tmp<<n) | carry);
-            carry = digit(tmp>>(BI_DIGIT_BITS-n));
+            digit carry = digits[len-1]>>(BI_DIGIT_BITS-n);
+            for(int i = len-1; i > 0; i--) digits[i+dig] = (digits[i]<<n) | (digits[i-1]>>(BI_DIGIT_BITS-n));
+            digits[dig] = digits[0]<<n;
+            if(carry) digits[len+dig] = carry;
+            len += carry ? 1 : 0;
         }
         len += dig;
-        if(carry) digits[len++] = carry;
         if(dig) memset(digits, 0, dig*sizeof(digit));
         return *this;
     }
 
+    /// the n-th 32 bit word, zero past the end
+    uint getword(int n) const
+    {
+        int i = n*32/BI_DIGIT_BITS;
+        return i < len ? uint(digits[i]>>(n*32%BI_DIGIT_BITS)) : 0;
+    }
+
+    void setwords(const uint *words, int n)
+    {
+        memset(digits, 0, ((n*32+BI_DIGIT_BITS-1)/BI_DIGIT_BITS)*sizeof(digit));
+        loopi(n) digits[i*32/BI_DIGIT_BITS] |= digit(words[i])<<(i*32%BI_DIGIT_BITS);
+        len = (n*32+BI_DIGIT_BITS-1)/BI_DIGIT_BITS;
+        shrink();
+    }
+
     void zerodigits(int i, int n)
     {
         memset(&digits[i], 0, n*sizeof(digit));
@@ -517,71 +588,51 @@ struct gfield : gfint
         }
         else if(*this >= P) gfint::sub(*this, P);
 #elif GF_BITS==256
-        // B = T + 2*S1 + 2*S2 + S3 + S4 - D1 - D2 - D3 - D4 mod p
-        copyshrinkdigits(result, GF_DIGITS); // T
-
-        if(result.morebits(256))
+        // B = T + 2*S1 + 2*S2 + S3 + S4 - D1 - D2 - D3 - D4 mod p, summed per 32 bit word
+        if(!result.morebits(256))
         {
-            gfield s;
-            if(result.morebits(352))
-            {
-                s.zerobits(0, 96);
-                s.copybits(96, result, 352, 160);
-                s.shrinkdigits(GF_DIGITS);
-                add(s); add(s); // S1
-            
-                if(result.morebits(384))
-                {
-                    //s.zerobits(0, 96);
-                    s.copybits(96, result, 384, 128);
-                    s.shrinkbits(224);
-                    add(s); add(s); // S2
-                }
-            }
-
-            s.copybits(0, result, 256, 96);
-            s.zerobits(96, 96);
-            s.copybits(192, result, 448, 64);
-            s.shrinkdigits(GF_DIGITS);
-            add(s); // S3
-           
-            s.copybits(0, result, 288, 96);
-            s.copybits(96, result, 416, 96);
-            s.dupbits(192, 96, 32);
-            s.copybits(224, result, 256, 32); 
-            s.shrinkdigits(GF_DIGITS);
-            add(s); // S4
-
-            s.copybits(0, result, 352, 96);
-            s.zerobits(96, 96);
-            s.copybits(192, result, 256, 32);
-            s.copybits(224, result, 320, 32);
-            s.shrinkdigits(GF_DIGITS);
-            sub(s); // D1
-
-            s.copybits(0, result, 384, 128);
-            //s.zerobits(128, 64);
-            s.copybits(192, result, 288, 32);
-            s.copybits(224, result, 352, 32);
-            s.shrinkdigits(GF_DIGITS);
-            sub(s); // D2
-
-            s.copybits(0, result, 416, 96);
-            s.copybits(96, result, 256, 96);
-            s.zerobits(192, 32);
-            s.copybits(224, result, 384, 32);
-            s.shrinkdigits(GF_DIGITS);
-            sub(s); // D3
-
-            s.copybits(0, result, 448, 64);
-            s.zerobits(64, 32);
-            s.copybits(96, result, 288, 96);
-            //s.zerobits(192, 32);
-            s.copybits(224, result, 416, 32);
-            s.shrinkdigits(GF_DIGITS);
-            sub(s); // D4
+            copyshrinkdigits(result, GF_DIGITS);
+            if(*this >= P) gfint::sub(*this, P);
+            return;
         }
-        else if(*this >= P) gfint::sub(*this, P);
+        static const signed char terms[8][16] =
+        {
+            // weight of c0..c15 in each result word
+            { 1,0,0,0,0,0,0,0, 1,1,0,-1,-1,-1,-1,0 },
+            { 0,1,0,0,0,0,0,0, 0,1,1,0,-1,-1,-1,-1 },
+            { 0,0,1,0,0,0,0,0, 0,0,1,1,0,-1,-1,-1 },
+            { 0,0,0,1,0,0,0,0, -1,-1,0,2,2,1,0,-1 },
+            { 0,0,0,0,1,0,0,0, 0,-1,-1,0,2,2,1,0 },
+            { 0,0,0,0,0,1,0,0, 0,0,-1,-1,0,2,2,1 },
+            { 0,0,0,0,0,0,1,0, -1,-1,0,0,0,1,3,2 },
+            { 0,0,0,0,0,0,0,1, 1,0,-1,-1,-1,-1,0,3 },
+        };
+        long long c[16], carry = 0;
+        loopi(16) c[i] = result.getword(i);
+        uint words[8];
+        loopi(8)
+        {
+            long long sum = carry;
+            loopj(16) sum += terms[i][j]*c[j];
+            words[i] = uint(sum);
+            carry = sum >> 32;
+        }
+        // fold the small signed overflow back in with multiples of P
+        static const uint pwords[8] = { 0xFFFFFFFFU, 0xFFFFFFFFU, 0xFFFFFFFFU, 0, 0, 0, 1, 0xFFFFFFFFU };
+        while(carry < 0)
+        {
+            long long sum = 0;
+            loopi(8) { sum += (long long)words[i] + pwords[i]; words[i] = uint(sum); sum >>= 32; }
+            carry += sum;
+        }
+        while(carry > 0)
+        {
+            long long sum = 0;
+            loopi(8) { sum += (long long)words[i] - pwords[i]; words[i] = uint(sum); sum >>= 32; }
+            carry += sum;
+        }
+        setwords(words, 8);
+        while(*this >= P) gfint::sub(*this, P);
 #else
 #error Unsupported GF
 #endif
@@ -688,11 +739,17 @@ struct gfield : gfint
     bool sqrt() { return sqrt(*this); }
 };
 
+#define EC_BASEWINDOW 4
+#define EC_BASEENTRIES ((1<<EC_BASEWINDOW)-1)
+#define EC_BASEWINDOWS ((GF_BITS+EC_BASEWINDOW-1)/EC_BASEWINDOW)
+#define EC_WNAF 5
+
 struct ecjacobian
 {
     static const gfield B;
     static const ecjacobian base;
     static const ecjacobian origin;
+    static ecjacobian *basetable;
 
     gfield x, y, z;
 
@@ -748,17 +805,79 @@ struct ecjacobian
         y.sub(f, x).sub(x).mul(b).sub(e.mul(a).mul(d)).div2();
     }
 
+    /// recodes q into width EC_WNAF non-adjacent form: odd digits in (-2^(EC_WNAF-1), 2^(EC_WNAF-1))
+    /// with at least EC_WNAF-1 zeros between them; returns the number of digits
+    template<int Q_DIGITS> static int wnaf(const bigint<Q_DIGITS> &q, signed char *naf)
+    {
+        int bits = q.numbits(), i = 0, carry = 0;
+        while(i < bits || carry)
+        {
+            if(int(q.hasbit(i)) == carry) { naf[i++] = 0; continue; }
+            int word = carry;
+            loopj(EC_WNAF) if(q.hasbit(i+j)) word += 1<<j;
+            carry = (word>>(EC_WNAF-1))&1;
+            naf[i++] = word - (carry<<EC_WNAF);
+            loopj(EC_WNAF-1) naf[i++] = 0;
+        }
+        return i;
+    }
+
     template<int Q_DIGITS> void mul(const ecjacobian &p, const bigint<Q_DIGITS> &q)
     {
+        ecjacobian odd[1<<(EC_WNAF-2)], p2(p); // p, 3p, 5p, ...
+        odd[0] = p;
+        p2.mul2();
+        for(int i = 1; i < int(sizeof(odd)/sizeof(odd[0])); i++) { odd[i] = odd[i-1]; odd[i].add(p2); }
+        signed char naf[Q_DIGITS*BI_DIGIT_BITS + EC_WNAF + 1];
+        int n = wnaf(q, naf);
         *this = origin;
-        loopirev(q.numbits())
+        loopirev(n)
         {
             mul2();
-            if(q.hasbit(i)) add(p);
+            int d = naf[i];
+            if(d > 0) add(odd[d>>1]);
+            else if(d < 0)
+            {
+                ecjacobian neg(odd[(-d)>>1]);
+                neg.y.neg();
+                add(neg);
+            }
         }
     }
     template<int Q_DIGITS> void mul(const bigint<Q_DIGITS> &q) { ecjacobian tmp(*this); mul(tmp, q); }
 
+    /// builds basetable: row i holds 1..EC_BASEENTRIES times base*2^(i*EC_BASEWINDOW) in affine form,
+    /// so a multiple of the base point is one mixed addition per window and no doublings
+    static void initbasetable()
+    {
+        if(basetable) return;
+        ecjacobian *table = new ecjacobian[EC_BASEWINDOWS*EC_BASEENTRIES], p(base);
+        loopi(EC_BASEWINDOWS)
+        {
+            ecjacobian *row = &table[i*EC_BASEENTRIES];
+            row[0] = p;
+            for(int j = 1; j < EC_BASEENTRIES; j++) { row[j] = row[j-1]; row[j].add(p); }
+            p = row[EC_BASEENTRIES-1];
+            p.add(row[0]);
+        }
+        normalize(table, EC_BASEWINDOWS*EC_BASEENTRIES);
+        basetable = table;
+    }
+
+    template<int Q_DIGITS> void mulbase(const bigint<Q_DIGITS> &q)
+    {
+        int bits = q.numbits();
+        if(bits > EC_BASEWINDOWS*EC_BASEWINDOW) { mul(base, q); return; }
+        initbasetable();
+        *this = origin;
+        for(int i = 0, w = 0; i < bits; i += EC_BASEWINDOW, w++)
+        {
+            int d = 0;
+            loopj(EC_BASEWINDOW) if(q.hasbit(i+j)) d |= 1<<j;
+            if(d) add(basetable[w*EC_BASEENTRIES + d-1]);
+        }
+    }
+
     void normalize()
     {
         if(z.iszero() || z.isone()) return;
@@ -770,6 +889,32 @@ struct ecjacobian
         z = bigint<1>(1);
     }
 
+    /// normalizes n points with a single inversion (Montgomery's trick)
+    static void normalize(ecjacobian *p, int n)
+    {
+        if(n <= 0) return;
+        gfield *prods = new gfield[n], acc(bigint<1>(1)), inv, zinv, tmp;
+        loopi(n)
+        {
+            if(!p[i].z.iszero()) acc.mul(p[i].z);
+            prods[i] = acc;
+        }
+        inv.invert(acc);
+        loopirev(n)
+        {
+            ecjacobian &q = p[i];
+            if(q.z.iszero()) continue;
+            if(i > 0) zinv.mul(inv, prods[i-1]);
+            else zinv = inv;
+            inv.mul(q.z);
+            tmp.square(zinv);
+            q.x.mul(tmp);
+            q.y.mul(tmp).mul(zinv);
+            q.z = bigint<1>(1);
+        }
+        delete[] prods;
+    }
+
     bool calcy(bool ybit)
     {
         gfield y2, tmp;
@@ -796,6 +941,7 @@ struct ecjacobian
 };
 
 const ecjacobian ecjacobian::origin(gfield((gfield::digit)1), gfield((gfield::digit)1), gfield((gfield::digit)0));
+ecjacobian *ecjacobian::basetable = NULL;
 
 #if GF_BITS==192
 const gfield gfield::P("fffffffffffffffffffffffffffffffeffffffffffffffff");
@@ -847,18 +993,16 @@ void genprivkey(const char *seed, vector<char> &privstr, vector<char> &pubstr)
     privkey.printdigits(privstr);
     privstr.add('\0');
 
-    ecjacobian c(ecjacobian::base);
-    c.mul(privkey);
+    ecjacobian c;
+    c.mulbase(privkey);
     c.normalize();
     c.print(pubstr);
     pubstr.add('\0');
 }
 
-bool hashstring(const char *str, char *result, int maxlen)
+static bool printhash(const tiger::hashval &hv, char *result, int maxlen)
 {
-    tiger::hashval hv;
     if(maxlen < 2*(int)sizeof(hv.bytes) + 1) return false;
-    tiger::hash((uchar *)str, strlen(str), hv);
     loopi(sizeof(hv.bytes))
     {
         uchar c = hv.bytes[i];
@@ -869,6 +1013,31 @@ bool hashstring(const char *str, char *result, int maxlen)
     return true;
 }
 
+bool hashstring(const char *str, char *result, int maxlen)
+{
+    tiger::hashval hv;
+    tiger::hash((uchar *)str, strlen(str), hv);
+    return printhash(hv, result, maxlen);
+}
+
+void *newhash()
+{
+    return new tiger::hasher;
+}
+
+void updatehash(void *h, const void *data, int len)
+{
+    ((tiger::hasher *)h)->update((const uchar *)data, len);
+}
+
+bool finishhash(void *h, char *result, int maxlen)
+{
+    tiger::hashval hv;
+    ((tiger::hasher *)h)->finish(hv);
+    delete (tiger::hasher *)h;
+    return printhash(hv, result, maxlen);
+}
+
 void answerchallenge(const char *privstr, const char *challenge, vector<char> &answerstr)
 {
     gfint privkey;
@@ -906,8 +1075,8 @@ void *genchallenge(void *pubkey, const void *seed, int seedlen, vector<char> &ch
     answer.mul(challenge);
     answer.normalize();
 
-    ecjacobian secret(ecjacobian::base);
-    secret.mul(challenge);
+    ecjacobian secret;
+    secret.mulbase(challenge);
     secret.normalize();
 
     secret.print(challengestr);
@@ -921,6 +1090,12 @@ void freechallenge(void *answer)
     delete (gfint *)answer;
 }
 
+void initchallenges()
+{
+    tiger::init();
+    ecjacobian::initbasetable();
+}
+
 bool checkchallenge(const char *answerstr, void *correct)
 {
     gfint answer(answerstr);
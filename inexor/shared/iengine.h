@@ -50,6 +50,12 @@ extern float raycubepos(const vec &o, const vec &ray, vec &hit, float radius = 0
 extern float rayfloor  (const vec &o, vec &floor, int mode = 0, float radius = 0);
 extern bool  raycubelos(const vec &o, const vec &dest, vec &hitpos);
 
+struct ShadowRayCache;
+extern ShadowRayCache *newshadowraycache();
+extern void freeshadowraycache(ShadowRayCache *&cache);
+extern void resetshadowraycache(ShadowRayCache *cache);
+extern int   raycubelos(ShadowRayCache *cache, const vec &o, const vec &dest, vec &hitpos);
+
 extern int thirdperson;
 extern bool isthirdperson();
 
@@ -229,6 +235,13 @@ extern void renderentring(const extentity &e, float radius, int axis = 0);
 // main
 extern void fatal(const char *s, ...) PRINTFARGS(1, 2);
 
+// jobs
+#define MAXJOBTHREADS 17
+
+typedef void (*jobfunc)(void *data, int index, int thread);
+extern int numjobthreads();
+extern void runjobs(jobfunc job, void *data, int count, int batch = 1);
+
 // rendertext
 extern bool setfont(const char *name);
 extern void pushfont();
@@ -339,6 +352,7 @@ extern void getmapfilename(const char *fname, const char *cname, char *mapname);
 extern uint getmapcrc();
 extern void clearmapcrc();
 extern bool loadents(const char *fname, vector<entity> &ents, uint *crc = NULL);
+extern bool precachemapents(const char *fname);
 
 // physics
 extern vec collidewall;
@@ -458,10 +472,14 @@ extern void notifywelcome();
 // crypto
 extern void genprivkey(const char *seed, vector<char> &privstr, vector<char> &pubstr);
 extern bool hashstring(const char *str, char *result, int maxlen);
+extern void *newhash(); ///< starts an incremental hash, finished and freed by finishhash()
+extern void updatehash(void *h, const void *data, int len);
+extern bool finishhash(void *h, char *result, int maxlen);
 extern void answerchallenge(const char *privstr, const char *challenge, vector<char> &answerstr);
 extern void *parsepubkey(const char *pubstr);
 extern void freepubkey(void *pubkey);
 extern void *genchallenge(void *pubkey, const void *seed, int seedlen, vector<char> &challengestr);
+extern void initchallenges(); ///< builds the tables genchallenge() shares; call before generating challenges on several threads
 extern void freechallenge(void *answer);
 extern bool checkchallenge(const char *answerstr, void *correct);
 
@@ -52,6 +52,7 @@ namespace game
 
     extern void updateworld();
     extern void initclient();
+    extern void cleargame();
     extern void physicstrigger(physent *d, bool local, int floorlevel, int waterlevel, int material = 0);
     extern void bounced(physent *d, const vec &surface);
     extern void edittrigger(const selinfo &sel, int op, int arg1 = 0, int arg2 = 0, int arg3 = 0);
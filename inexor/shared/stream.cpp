@@ -738,7 +738,7 @@ struct gzstream : stream
     {
         MAGIC1   = 0x1F,
         MAGIC2   = 0x8B,
-        BUFSIZE  = 16384,
+        BUFSIZE  = 1<<16,
         OS_UNIX  = 0x03
     };
 
@@ -755,11 +755,18 @@ struct gzstream : stream
     stream *file;
     z_stream zfile;
     uchar *buf;
+    // small reads are served from inflated data in data[datapos..datalen), small writes are
+    // gathered in data[0..datalen) so zlib is only ever called on whole buffers
+    uchar *data;
+    size_t datapos, datalen, crcpos;
     bool reading, writing, autoclose;
     uint crc;
+#ifndef STANDALONE
+    uint inflatedcrc;
+#endif
     size_t headersize;
 
-    gzstream() : file(NULL), buf(NULL), reading(false), writing(false), autoclose(false), crc(0), headersize(0)
+    gzstream() : file(NULL), buf(NULL), data(NULL), datapos(0), datalen(0), crcpos(0), reading(false), writing(false), autoclose(false), crc(0), headersize(0)
     {
         zfile.zalloc = NULL;
         zfile.zfree = NULL;
@@ -808,21 +815,37 @@ struct gzstream : stream
         file->seek(n, SEEK_CUR);
     }
 
+    void skipstring()
+    {
+        for(;;)
+        {
+            if(!zfile.avail_in) readbuf();
+            if(!zfile.avail_in) return;
+            uchar *end = (uchar *)memchr(zfile.next_in, '\0', zfile.avail_in);
+            size_t skipped = end ? end+1 - (uchar *)zfile.next_in : zfile.avail_in;
+            zfile.avail_in -= skipped;
+            zfile.next_in += skipped;
+            if(end) return;
+        }
+    }
+
     bool checkheader()
     {
-        readbuf(10);
-        if(readbyte() != MAGIC1 || readbyte() != MAGIC2 || readbyte() != Z_DEFLATED) return false;
-        uchar flags = readbyte();
+        readbuf();
+        if(zfile.avail_in < 10) return false;
+        const uchar *header = zfile.next_in;
+        if(header[0] != MAGIC1 || header[1] != MAGIC2 || header[2] != Z_DEFLATED) return false;
+        uchar flags = header[3];
         if(flags & F_RESERVED) return false;
-        skipbytes(6);
+        skipbytes(10);
         if(flags & F_EXTRA)
         {
-            size_t len = readbyte(512);
-            len |= size_t(readbyte(512))<<8;
+            size_t len = readbyte();
+            len |= size_t(readbyte())<<8;
             skipbytes(len);
         }
-        if(flags & F_NAME) while(readbyte(512));
-        if(flags & F_COMMENT) while(readbyte(512));
+        if(flags & F_NAME) skipstring();
+        if(flags & F_COMMENT) skipstring();
         if(flags & F_CRC) skipbytes(2);
         headersize = size_t(file->tell() - zfile.avail_in);
         return zfile.avail_in > 0 || !file->end();
@@ -845,7 +868,12 @@ struct gzstream : stream
 
         file = f;
         crc = crc32(0, NULL, 0);
+#ifndef STANDALONE
+        inflatedcrc = crc;
+#endif
         buf = new uchar[BUFSIZE];
+        data = new uchar[BUFSIZE];
+        datapos = datalen = crcpos = 0;
 
         if(reading)
         {
@@ -857,7 +885,18 @@ struct gzstream : stream
         return true;
     }
 
-    uint getcrc() { return crc; }
+    void updatecrc()
+    {
+        if(datapos > crcpos) crc = crc32(crc, &data[crcpos], datapos - crcpos);
+        crcpos = datapos;
+    }
+
+    uint getcrc()
+    {
+        if(writing) return crc32(crc, data, datalen);
+        updatecrc();
+        return crc;
+    }
 
     void finishreading()
     {
@@ -868,8 +907,8 @@ struct gzstream : stream
             uint checkcrc = 0, checksize = 0;
             loopi(4) checkcrc |= uint(readbyte()) << (i*8);
             loopi(4) checksize |= uint(readbyte()) << (i*8);
-            if(checkcrc != crc)
-                conoutf(CON_DEBUG, "gzip crc check failed: read %X, calculated %X", checkcrc, crc);
+            if(checkcrc != inflatedcrc)
+                conoutf(CON_DEBUG, "gzip crc check failed: read %X, calculated %X", checkcrc, inflatedcrc);
             if(checksize != zfile.total_out)
                 conoutf(CON_DEBUG, "gzip size check failed: read %u, calculated %u", checksize, uint(zfile.total_out));
         }
@@ -886,6 +925,7 @@ struct gzstream : stream
     void finishwriting()
     {
         if(!writing) return;
+        deflatedata();
         for(;;)
         {
             int err = zfile.avail_out > 0 ? deflate(&zfile, Z_FINISH) : Z_OK;
@@ -915,11 +955,13 @@ struct gzstream : stream
         if(writing) finishwriting();
         stopwriting();
         DELETEA(buf);
+        DELETEA(data);
+        datapos = datalen = crcpos = 0;
         if(autoclose) DELETEP(file);
     }
 
-    bool end() { return !reading && !writing; }
-    offset tell() { return reading ? zfile.total_out : (writing ? zfile.total_in : offset(-1)); }
+    bool end() { return !reading && !writing && datapos >= datalen; }
+    offset tell() { return writing ? offset(zfile.total_in + datalen) : (reading || datapos < datalen ? offset(zfile.total_out - (datalen - datapos)) : offset(-1)); }
     offset rawtell() { return file ? file->tell() : offset(-1); }
 
     offset size()
@@ -935,7 +977,7 @@ struct gzstream : stream
 
     bool seek(offset pos, int whence)
     {
-        if(writing || !reading) return false;
+        if(writing || (!reading && datapos >= datalen)) return false;
 
         if(whence == SEEK_END)
         {
@@ -943,13 +985,21 @@ struct gzstream : stream
             while(read(skip, sizeof(skip)) == sizeof(skip));
             return !pos;
         }
-        else if(whence == SEEK_CUR) pos += zfile.total_out;
+        else if(whence == SEEK_CUR) pos += tell();
 
-        if(pos >= (offset)zfile.total_out) pos -= zfile.total_out;
+        offset cur = tell();
+        if(pos >= cur) pos -= cur;
         else if(pos < 0 || !file->seek(headersize, SEEK_SET)) return false;
         else
         {
-            if(zfile.next_in && zfile.total_in <= uint(zfile.next_in - buf))
+            if(!reading)
+            {
+                if(inflateInit2(&zfile, -MAX_WBITS) != Z_OK) return false;
+                reading = true;
+                zfile.avail_in = 0;
+                zfile.next_in = NULL;
+            }
+            else if(zfile.next_in && zfile.total_in <= uint(zfile.next_in - buf))
             {
                 zfile.avail_in += zfile.total_in;
                 zfile.next_in -= zfile.total_in;
@@ -960,25 +1010,30 @@ struct gzstream : stream
                 zfile.next_in = NULL;
             }
             inflateReset(&zfile);
+            datapos = datalen = crcpos = 0;
             crc = crc32(0, NULL, 0);
+#ifndef STANDALONE
+            inflatedcrc = crc;
+#endif
         }
 
-        uchar skip[512];
         while(pos > 0)
         {
-            size_t skipped = (size_t)min(pos, (offset)sizeof(skip));
-            if(read(skip, skipped) != skipped) { stopreading(); return false; }
+            if(datapos >= datalen && !inflatedata()) { stopreading(); return false; }
+            size_t skipped = (size_t)min(pos, offset(datalen - datapos));
+            datapos += skipped;
             pos -= skipped;
         }
 
         return true;
     }
 
-    size_t read(void *buf, size_t len)
+    size_t inflatebuf(uchar *dst, size_t len)
     {
-        if(!reading || !buf || !len) return 0;
-        zfile.next_out = (Bytef *)buf;
+        if(!reading) return 0;
+        zfile.next_out = (Bytef *)dst;
         zfile.avail_out = len;
+        bool done = false;
         while(zfile.avail_out > 0)
         {
             if(!zfile.avail_in)
@@ -987,11 +1042,57 @@ struct gzstream : stream
                 if(!zfile.avail_in) { stopreading(); break; }
             }
             int err = inflate(&zfile, Z_NO_FLUSH);
-            if(err == Z_STREAM_END) { crc = crc32(crc, (Bytef *)buf, len - zfile.avail_out); finishreading(); stopreading(); return len - zfile.avail_out; }
+            if(err == Z_STREAM_END) { done = true; break; }
             else if(err != Z_OK) { stopreading(); break; }
         }
-        crc = crc32(crc, (Bytef *)buf, len - zfile.avail_out);
-        return len - zfile.avail_out;
+        len -= zfile.avail_out;
+#ifndef STANDALONE
+        if(dbggz) inflatedcrc = crc32(inflatedcrc, dst, len);
+#endif
+        if(done) { finishreading(); stopreading(); }
+        return len;
+    }
+
+    bool inflatedata()
+    {
+        updatecrc();
+        datapos = crcpos = 0;
+        datalen = inflatebuf(data, BUFSIZE);
+        return datalen > 0;
+    }
+
+    size_t read(void *dst, size_t len)
+    {
+        if(!dst || !len) return 0;
+        size_t next = 0;
+        while(next < len)
+        {
+            if(datapos < datalen)
+            {
+                size_t n = min(len - next, datalen - datapos);
+                memcpy(&((uchar *)dst)[next], &data[datapos], n);
+                next += n;
+                datapos += n;
+            }
+            else if(!reading) break;
+            else if(len - next >= BUFSIZE/2)
+            {
+                // large reads inflate straight into the caller's buffer
+                updatecrc();
+                size_t n = inflatebuf(&((uchar *)dst)[next], len - next);
+                if(!n) break;
+                crc = crc32(crc, &((uchar *)dst)[next], n);
+                next += n;
+            }
+            else if(!inflatedata()) break;
+        }
+        return next;
+    }
+
+    int getchar()
+    {
+        if(datapos >= datalen && (!reading || !inflatedata())) return -1;
+        return data[datapos++];
     }
 
     bool flushbuf(bool full = false)
@@ -1007,23 +1108,239 @@ struct gzstream : stream
         return true;
     }
 
-    bool flush() { return flushbuf(true); }
-
-    size_t write(const void *buf, size_t len)
+    bool deflatebuf(const uchar *src, size_t len)
     {
-        if(!writing || !buf || !len) return 0;
-        zfile.next_in = (Bytef *)buf;
+        zfile.next_in = (Bytef *)src;
         zfile.avail_in = len;
         while(zfile.avail_in > 0)
         {
-            if(!zfile.avail_out && !flushbuf()) { stopwriting(); break; }
+            if(!zfile.avail_out && !flushbuf()) { stopwriting(); return false; }
             int err = deflate(&zfile, Z_NO_FLUSH);
-            if(err != Z_OK) { stopwriting(); break; }
+            if(err != Z_OK) { stopwriting(); return false; }
+        }
+        crc = crc32(crc, src, len);
+        return true;
+    }
+
+    bool deflatedata()
+    {
+        if(!datalen) return true;
+        size_t len = datalen;
+        datalen = 0;
+        return deflatebuf(data, len);
+    }
+
+    bool flush() { return writing && deflatedata() && flushbuf(true); }
+
+    size_t write(const void *src, size_t len)
+    {
+        if(!writing || !src || !len) return 0;
+        if(datalen + len <= BUFSIZE)
+        {
+            memcpy(&data[datalen], src, len);
+            datalen += len;
+            return len;
+        }
+        if(!deflatedata()) return 0;
+        if(len < BUFSIZE/2)
+        {
+            memcpy(data, src, len);
+            datalen = len;
+            return len;
+        }
+        return deflatebuf((const uchar *)src, len) ? len : 0;
+    }
+
+    bool putchar(int c)
+    {
+        if(!writing) return false;
+        if(datalen >= BUFSIZE && !deflatedata()) return false;
+        data[datalen++] = uchar(c);
+        return true;
+    }
+};
+
+#ifndef STANDALONE
+/// read-ahead stream: a worker thread pulls blocks out of the source stream
+/// (typically a gzstream, so inflating happens there) while the caller
+/// decodes the previous blocks
+struct prefetchstream : stream
+{
+    enum
+    {
+        BLOCKSIZE = 1<<16,
+        NUMBLOCKS = 8
+    };
+
+    struct block
+    {
+        uchar *data;
+        size_t len;
+    };
+
+    stream *file;
+    SDL_Thread *thread;
+    SDL_mutex *lock;
+    SDL_cond *fullcond, *emptycond;
+    block blocks[NUMBLOCKS];
+    int readblock, numfull;
+    uchar *cur;
+    size_t curlen, readpos;
+    offset consumed;
+    uint crc;
+    bool reading, finished, stopped, autoclose;
+
+    prefetchstream() : file(NULL), thread(NULL), lock(NULL), fullcond(NULL), emptycond(NULL), readblock(0), numfull(0), cur(NULL), curlen(0), readpos(0), consumed(0), crc(0), reading(false), finished(false), stopped(false), autoclose(false)
+    {
+        loopi(NUMBLOCKS) { blocks[i].data = NULL; blocks[i].len = 0; }
+    }
+
+    ~prefetchstream()
+    {
+        close();
+    }
+
+    static int prefetch(void *data)
+    {
+        ((prefetchstream *)data)->fill();
+        return 0;
+    }
+
+    void fill()
+    {
+        int writeblock = 0;
+        for(;;)
+        {
+            SDL_LockMutex(lock);
+            while(numfull >= NUMBLOCKS && !stopped) SDL_CondWait(emptycond, lock);
+            bool stop = stopped;
+            SDL_UnlockMutex(lock);
+            if(stop) break;
+
+            // the consumer never touches blocks beyond readblock+numfull, so this one is ours until published
+            block &b = blocks[writeblock];
+            b.len = file->read(b.data, BLOCKSIZE);
+
+            SDL_LockMutex(lock);
+            if(b.len > 0) { numfull++; writeblock = (writeblock+1)%NUMBLOCKS; }
+            if(b.len < BLOCKSIZE) finished = true;
+            stop = finished;
+            SDL_CondSignal(fullcond);
+            SDL_UnlockMutex(lock);
+            if(stop) break;
+        }
+    }
+
+    bool open(stream *f, bool needclose)
+    {
+        if(file) return false;
+        file = f;
+        crc = crc32(0, NULL, 0);
+        lock = SDL_CreateMutex();
+        fullcond = SDL_CreateCond();
+        emptycond = SDL_CreateCond();
+        if(!lock || !fullcond || !emptycond) { file = NULL; return false; }
+        loopi(NUMBLOCKS) blocks[i].data = new uchar[BLOCKSIZE];
+        thread = SDL_CreateThread(prefetch, "prefetch", this);
+        if(!thread) { file = NULL; return false; }
+        reading = true;
+        autoclose = needclose;
+        return true;
+    }
+
+    void releaseblock()
+    {
+        if(!cur) return;
+        crc = crc32(crc, cur, curlen);
+        consumed += curlen;
+        cur = NULL;
+        curlen = readpos = 0;
+        SDL_LockMutex(lock);
+        numfull--;
+        readblock = (readblock+1)%NUMBLOCKS;
+        SDL_CondSignal(emptycond);
+        SDL_UnlockMutex(lock);
+    }
+
+    bool nextblock()
+    {
+        releaseblock();
+        SDL_LockMutex(lock);
+        while(!numfull && !finished) SDL_CondWait(fullcond, lock);
+        bool avail = numfull > 0;
+        SDL_UnlockMutex(lock);
+        if(!avail) { reading = false; return false; }
+        cur = blocks[readblock].data;
+        curlen = blocks[readblock].len;
+        return true;
+    }
+
+    void close()
+    {
+        if(thread)
+        {
+            SDL_LockMutex(lock);
+            stopped = true;
+            SDL_CondSignal(emptycond);
+            SDL_UnlockMutex(lock);
+            SDL_WaitThread(thread, NULL);
+            thread = NULL;
         }
-        crc = crc32(crc, (Bytef *)buf, len - zfile.avail_in);
-        return len - zfile.avail_in;
+        reading = false;
+        cur = NULL;
+        curlen = readpos = 0;
+        loopi(NUMBLOCKS) DELETEA(blocks[i].data);
+        if(emptycond) { SDL_DestroyCond(emptycond); emptycond = NULL; }
+        if(fullcond) { SDL_DestroyCond(fullcond); fullcond = NULL; }
+        if(lock) { SDL_DestroyMutex(lock); lock = NULL; }
+        if(autoclose) DELETEP(file);
+    }
+
+    bool end() { return !reading; }
+    offset tell() { return consumed + readpos; }
+    uint getcrc() { return cur ? crc32(crc, cur, readpos) : crc; }
+
+    bool seek(offset pos, int whence)
+    {
+        if(whence == SEEK_END)
+        {
+            while(reading) if(!nextblock()) break;
+            return !pos;
+        }
+        else if(whence == SEEK_SET) pos -= tell();
+        if(pos < 0) return false;
+        while(pos > 0)
+        {
+            if(readpos >= curlen && !nextblock()) return false;
+            size_t skipped = (size_t)min(pos, offset(curlen - readpos));
+            readpos += skipped;
+            pos -= skipped;
+        }
+        return true;
+    }
+
+    size_t read(void *buf, size_t len)
+    {
+        if(!reading || !buf || !len) return 0;
+        size_t next = 0;
+        while(next < len)
+        {
+            if(readpos >= curlen && !nextblock()) break;
+            size_t n = min(len - next, curlen - readpos);
+            memcpy(&((uchar *)buf)[next], &cur[readpos], n);
+            next += n;
+            readpos += n;
+        }
+        return next;
+    }
+
+    int getchar()
+    {
+        if(readpos >= curlen && (!reading || !nextblock())) return -1;
+        return cur[readpos++];
     }
 };
+#endif
 
 struct utf8stream : stream
 {
@@ -1232,6 +1549,16 @@ stream *opengzfile(const char *filename, const char *mode, stream *file, int lev
     return gz;
 }
 
+#ifndef STANDALONE
+stream *openprefetchstream(stream *file, bool needclose)
+{
+    if(!file) return NULL;
+    prefetchstream *prefetch = new prefetchstream;
+    if(!prefetch->open(file, needclose)) { delete prefetch; return file; }
+    return prefetch;
+}
+#endif
+
 stream *openutf8file(const char *filename, const char *mode, stream *file)
 {
     stream *source = file ? file : openfile(filename, mode);
@@ -1264,3 +1591,243 @@ char *loadfile(const char *fn, size_t *size, bool utf8)
     if(size!=NULL) *size = len;
     return buf;
 }
+
+#ifndef STANDALONE
+/// asynchronous file requests
+/// paths are resolved (and zip archive members read) on the main thread, plain files are then
+/// read or written by a small pool of io threads, highest priority first;
+/// finished requests are handed back to their callbacks by checkasyncfiles() in the main loop
+VARP(iothreads, 1, 2, 8);
+
+struct asyncfile
+{
+    int id, priority;
+    bool writing, cancelled, ok;
+    char *name, *path;
+    uchar *data;
+    size_t len;
+    asyncfilecallback callback;
+    void *arg;
+
+    asyncfile() : id(0), priority(0), writing(false), cancelled(false), ok(false), name(NULL), path(NULL), data(NULL), len(0), callback(NULL), arg(NULL) {}
+    ~asyncfile()
+    {
+        DELETEA(name);
+        DELETEA(path);
+        DELETEA(data);
+    }
+
+    void readdata(stream *f)
+    {
+        stream::offset size = f->size();
+        if(size < 0) { delete f; return; }
+        len = size_t(size);
+        data = new uchar[len+1];
+        size_t n = f->read(data, len);
+        delete f;
+        if(n != len) { DELETEA(data); return; }
+        ok = true;
+    }
+
+    size_t writedata(stream *f)
+    {
+        size_t written = f->write(data, len);
+        delete f;
+        return written;
+    }
+
+    void run()
+    {
+        filestream *f = new filestream;
+        if(!f->open(path, writing ? "wb" : "rb")) { delete f; return; }
+        if(writing) ok = writedata(f) == len;
+        else readdata(f);
+    }
+};
+
+static SDL_mutex *asyncfilelock = NULL;
+static SDL_cond *asyncfilecond = NULL;
+static vector<SDL_Thread *> asyncfilethreads;
+static vector<asyncfile *> asyncfilequeue, asyncfilesrunning, asyncfilesdone;
+static int asyncfileid = 0;
+static bool asyncfilesexit = false, asyncfilesclosing = false;
+
+static int asyncfileworker(void *data)
+{
+    SDL_LockMutex(asyncfilelock);
+    for(;;)
+    {
+        while(!asyncfilesexit && asyncfilequeue.empty()) SDL_CondWait(asyncfilecond, asyncfilelock);
+        if(asyncfilequeue.empty()) break;
+        asyncfile *req = asyncfilequeue.remove(0);
+        asyncfilesrunning.add(req);
+        SDL_UnlockMutex(asyncfilelock);
+
+        req->run();
+
+        SDL_LockMutex(asyncfilelock);
+        asyncfilesrunning.removeobj(req);
+        asyncfilesdone.add(req);
+        SDL_CondBroadcast(asyncfilecond);
+    }
+    SDL_UnlockMutex(asyncfilelock);
+    return 0;
+}
+
+static bool initasyncfiles()
+{
+    if(asyncfilethreads.length()) return true;
+    asyncfilesexit = false;
+    loopi(iothreads)
+    {
+        SDL_Thread *thread = SDL_CreateThread(asyncfileworker, "io worker", NULL);
+        if(!thread) break;
+        asyncfilethreads.add(thread);
+    }
+    return asyncfilethreads.length() > 0;
+}
+
+static int queueasyncfile(asyncfile *req)
+{
+    if(!asyncfilelock) asyncfilelock = SDL_CreateMutex();
+    if(!asyncfilecond) asyncfilecond = SDL_CreateCond();
+    req->id = ++asyncfileid;
+    // once shutting down no new io starts, requests made by callbacks during cleanup just fail
+    if(asyncfilesclosing) DELETEA(req->path);
+    // requests that need no worker (missing files, zip members) complete on the next check,
+    // without any io threads the file is accessed right away
+    bool threaded = req->path && initasyncfiles();
+    if(req->path && !threaded) req->run();
+    SDL_LockMutex(asyncfilelock);
+    if(!threaded) asyncfilesdone.add(req);
+    else
+    {
+        int pos = asyncfilequeue.length();
+        while(pos > 0 && asyncfilequeue[pos-1]->priority < req->priority) pos--;
+        asyncfilequeue.insert(pos, req);
+        SDL_CondSignal(asyncfilecond);
+    }
+    SDL_UnlockMutex(asyncfilelock);
+    return req->id;
+}
+
+int asyncreadfile(const char *name, asyncfilecallback callback, void *arg, int priority)
+{
+    asyncfile *req = new asyncfile;
+    req->name = newstring(name);
+    req->priority = priority;
+    req->callback = callback;
+    req->arg = arg;
+    if(findzipfile(name))
+    {
+        stream *f = openzipfile(name, "rb");
+        if(f) req->readdata(f);
+    }
+    else
+    {
+        const char *found = findfile(name, "rb");
+        if(found && fileexists(found, "r")) req->path = newstring(found);
+    }
+    return queueasyncfile(req);
+}
+
+int asyncwritefile(const char *name, uchar *data, size_t len, asyncfilecallback callback, void *arg, int priority)
+{
+    asyncfile *req = new asyncfile;
+    req->writing = true;
+    req->name = newstring(name);
+    req->data = data;
+    req->len = len;
+    req->priority = priority;
+    req->callback = callback;
+    req->arg = arg;
+    const char *found = findfile(name, "wb");
+    if(found) req->path = newstring(found);
+    return queueasyncfile(req);
+}
+
+static asyncfile *findasyncfile(vector<asyncfile *> &reqs, int id)
+{
+    loopv(reqs) if(reqs[i]->id == id) return reqs[i];
+    return NULL;
+}
+
+bool cancelasyncfile(int id)
+{
+    if(!asyncfilelock) return false;
+    SDL_LockMutex(asyncfilelock);
+    asyncfile *queued = findasyncfile(asyncfilequeue, id), *pending = NULL;
+    if(queued) asyncfilequeue.removeobj(queued);
+    else
+    {
+        pending = findasyncfile(asyncfilesrunning, id);
+        if(!pending) pending = findasyncfile(asyncfilesdone, id);
+        if(pending) pending->cancelled = true;
+    }
+    SDL_UnlockMutex(asyncfilelock);
+    if(!queued) return pending != NULL;
+    delete queued;
+    return true;
+}
+
+static void finishasyncfile(asyncfile *req)
+{
+    if(!req->cancelled && req->callback)
+    {
+        if(!req->ok) DELETEA(req->data);
+        req->callback(req->id, req->name, req->ok, req->data, req->ok ? req->len : 0, req->arg);
+    }
+    delete req;
+}
+
+int checkasyncfiles()
+{
+    if(!asyncfilelock) return 0;
+    // local, since callbacks may issue or wait on other files and so come back in here
+    vector<asyncfile *> done;
+    SDL_LockMutex(asyncfilelock);
+    done.move(asyncfilesdone);
+    SDL_UnlockMutex(asyncfilelock);
+    loopv(done) finishasyncfile(done[i]);
+    return done.length();
+}
+
+bool waitasyncfile(int id)
+{
+    if(!asyncfilelock) return false;
+    SDL_LockMutex(asyncfilelock);
+    asyncfile *req = NULL;
+    for(;;)
+    {
+        if(findasyncfile(asyncfilequeue, id) || findasyncfile(asyncfilesrunning, id)) { SDL_CondWait(asyncfilecond, asyncfilelock); continue; }
+        req = findasyncfile(asyncfilesdone, id);
+        if(req) asyncfilesdone.removeobj(req);
+        break;
+    }
+    SDL_UnlockMutex(asyncfilelock);
+    if(!req) return false;
+    finishasyncfile(req);
+    return true;
+}
+
+void cleanupasyncfiles()
+{
+    if(!asyncfilelock) return;
+    asyncfilesclosing = true;
+    SDL_LockMutex(asyncfilelock);
+    // reads that never ran still report back as failed, so their callers can free their args,
+    // while queued writes are finished by the workers before they exit
+    loopv(asyncfilequeue) if(!asyncfilequeue[i]->writing) asyncfilesdone.add(asyncfilequeue.remove(i--));
+    asyncfilesexit = true;
+    SDL_CondBroadcast(asyncfilecond);
+    SDL_UnlockMutex(asyncfilelock);
+    loopv(asyncfilethreads) SDL_WaitThread(asyncfilethreads[i], NULL);
+    asyncfilethreads.setsize(0);
+    while(checkasyncfiles());
+    asyncfilesclosing = false;
+    SDL_DestroyCond(asyncfilecond);
+    SDL_DestroyMutex(asyncfilelock);
+    asyncfilecond = NULL;
+    asyncfilelock = NULL;
+}
+#endif
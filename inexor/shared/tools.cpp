@@ -231,3 +231,143 @@ int ipmask::print(char *buf) const
     return int(buf-start);
 }
 
+static inline enet_uint32 prefixmask(int len)
+{
+    return len > 0 ? 0xFFffFFff << (32 - len) : 0;
+}
+
+/// returns the cidr length of a (network byte order) mask, or -1 if it has holes
+static int masklength(enet_uint32 mask)
+{
+    mask = ENET_NET_TO_HOST_32(mask);
+    int len = 0;
+    while(len < 32 && mask & (0x80000000U >> len)) len++;
+    return mask == prefixmask(len) ? len : -1;
+}
+
+/// returns the node for the given prefix, splitting compressed paths as needed
+int ipmasktable::insert(enet_uint32 prefix, int len)
+{
+    int parent = -1, side = 0, cur = nodes.empty() ? -1 : 0;
+    if(nodes.empty())
+    {
+        node &root = nodes.add();
+        root.prefix = 0;
+        root.len = 0;
+        root.child[0] = root.child[1] = -1;
+        root.entry = -1;
+        cur = 0;
+    }
+    for(;;)
+    {
+        if(cur < 0)
+        {
+            cur = nodes.length();
+            node &n = nodes.add();
+            n.prefix = prefix;
+            n.len = len;
+            n.child[0] = n.child[1] = -1;
+            n.entry = -1;
+            nodes[parent].child[side] = cur;
+            return cur;
+        }
+        node &n = nodes[cur];
+        int common = min(n.len, len);
+        enet_uint32 diff = (n.prefix ^ prefix) & prefixmask(common);
+        if(diff) { common = 0; while(!(diff & (0x80000000U >> common))) common++; }
+        if(common == n.len)
+        {
+            if(len == n.len) return cur;
+            parent = cur;
+            side = (prefix >> (31 - n.len)) & 1;
+            cur = n.child[side];
+            continue;
+        }
+        // the new prefix branches off (or ends) within the compressed path of cur
+        int split = nodes.length();
+        node &s = nodes.add();
+        s.prefix = prefix & prefixmask(common);
+        s.len = common;
+        s.child[0] = s.child[1] = -1;
+        s.entry = -1;
+        s.child[(nodes[cur].prefix >> (31 - common)) & 1] = cur;
+        nodes[parent].child[side] = split;
+        if(common == len) return split;
+        parent = split;
+        side = (prefix >> (31 - common)) & 1;
+        cur = -1;
+    }
+}
+
+void ipmasktable::index(int i)
+{
+    entry &e = entries[i];
+    int len = masklength(e.mask.mask);
+    if(len < 0) { holes.add(i); return; }
+    int n = insert(ENET_NET_TO_HOST_32(e.mask.ip) & prefixmask(len), len);
+    int old = nodes[n].entry;
+    // the same mask added twice keeps whichever entry lasts longer
+    if(old < 0 || (entries[old].expires && (!e.expires || e.expire - entries[old].expire > 0))) nodes[n].entry = i;
+}
+
+void ipmasktable::add(const ipmask &m, int expire, bool expires)
+{
+    entry &e = entries.add();
+    e.mask = m;
+    e.mask.ip &= m.mask;
+    e.expire = expire;
+    e.expires = expires;
+    if(expires && (!expiring || nextexpire - expire > 0)) { nextexpire = expire; expiring = true; }
+    index(entries.length()-1);
+}
+
+bool ipmasktable::check(enet_uint32 host, int now) const
+{
+    #define CHECKENTRY(i) { const entry &e = entries[i]; if(!e.expires || e.expire - now > 0) return true; }
+    loopv(holes) if(entries[holes[i]].mask.check(host)) CHECKENTRY(holes[i]);
+    if(nodes.empty()) return false;
+    enet_uint32 bits = ENET_NET_TO_HOST_32(host);
+    for(int cur = 0; cur >= 0;)
+    {
+        const node &n = nodes[cur];
+        if((bits ^ n.prefix) & prefixmask(n.len)) break;
+        if(n.entry >= 0) CHECKENTRY(n.entry);
+        if(n.len >= 32) break;
+        cur = n.child[(bits >> (31 - n.len)) & 1];
+    }
+    #undef CHECKENTRY
+    return false;
+}
+
+void ipmasktable::prune(int now)
+{
+    if(!expiring || nextexpire - now > 0) return;
+    vector<entry> old;
+    old.move(entries);
+    clear();
+    loopv(old) if(!old[i].expires || old[i].expire - now > 0) add(old[i].mask, old[i].expire, old[i].expires);
+}
+
+int ipmasktable::load(const char *filename)
+{
+    char *buf = loadfile(path(filename, true), NULL);
+    if(!buf) return -1;
+    int n = 0;
+    for(char *line = buf; *line;)
+    {
+        char *end = line + strcspn(line, "\r\n");
+        char next = *end;
+        *end = '\0';
+        line += strspn(line, " \t");
+        if(*line && *line != '#' && (line[0] != '/' || line[1] != '/'))
+        {
+            ipmask m;
+            m.parse(line);
+            add(m);
+            n++;
+        }
+        line = next ? end + 1 : end;
+    }
+    delete[] buf;
+    return n;
+}
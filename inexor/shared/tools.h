@@ -1483,6 +1483,22 @@ extern stream *openfile(const char *filename, const char *mode);
 extern stream *opentempfile(const char *filename, const char *mode);
 extern stream *opengzfile(const char *filename, const char *mode, stream *file = NULL, int level = Z_BEST_COMPRESSION);
 extern stream *openutf8file(const char *filename, const char *mode, stream *file = NULL);
+#ifndef STANDALONE
+/// wrap a stream so that a worker thread reads (and for gzstreams, inflates) ahead of the caller;
+/// returns the source stream unchanged if the worker can not be started
+extern stream *openprefetchstream(stream *file, bool needclose = true);
+
+/// called from checkasyncfiles() on the main thread; ok is false, len 0 and data NULL if the request failed,
+/// data is freed afterwards unless the callback takes it over and sets it to NULL
+typedef void (*asyncfilecallback)(int id, const char *name, bool ok, uchar *&data, size_t len, void *arg);
+extern int asyncreadfile(const char *name, asyncfilecallback callback, void *arg = NULL, int priority = 0);
+/// takes ownership of data, which must be allocated with new[]
+extern int asyncwritefile(const char *name, uchar *data, size_t len, asyncfilecallback callback = NULL, void *arg = NULL, int priority = 0);
+extern bool cancelasyncfile(int id); ///< the callback is not run, so the caller keeps ownership of arg
+extern bool waitasyncfile(int id);
+extern int checkasyncfiles();
+extern void cleanupasyncfiles();
+#endif
 extern char *loadfile(const char *fn, size_t *size, bool utf8 = true);
 extern bool listdir(const char *dir, bool rel, const char *ext, vector<char *> &files);
 extern int listfiles(const char *dir, const char *ext, vector<char *> &files);
@@ -1518,6 +1534,60 @@ struct ipmask
     int print(char *buf) const;
     bool check(enet_uint32 host) const { return (host & mask) == ip; }
 };
+
+/// set of ipmasks that is checked in O(32) no matter how many masks it holds:
+/// cidr masks are stored in a path compressed binary trie, masks with holes ("1.*.3.4") are checked one by one;
+/// masks added with an expiry time stop matching once that time has passed (times are compared like totalmillis)
+struct ipmasktable
+{
+    struct entry
+    {
+        ipmask mask;
+        int expire;
+        bool expires;
+    };
+
+    struct node
+    {
+        enet_uint32 prefix; ///< host byte order, only the first len bits are used
+        int len;
+        int child[2];
+        int entry;          ///< index of the entry stored at this node, or -1
+    };
+
+    vector<entry> entries;
+    vector<node> nodes;
+    vector<int> holes;      ///< entries with non contiguous masks
+    int nextexpire;
+    bool expiring;
+
+    ipmasktable() : nextexpire(0), expiring(false) {}
+
+    int length() const { return entries.length(); }
+    bool empty() const { return entries.empty(); }
+    const ipmask &operator[](int i) const { return entries[i].mask; }
+
+    void clear()
+    {
+        entries.setsize(0);
+        nodes.setsize(0);
+        holes.setsize(0);
+        expiring = false;
+    }
+
+    void add(const ipmask &m) { add(m, 0, false); }
+    void add(const ipmask &m, int expire) { add(m, expire, true); }
+    void add(const ipmask &m, int expire, bool expires);
+    /// adds one mask per line of the given file, lines starting with '#' or "//" are skipped; returns the number of masks added
+    int load(const char *filename);
+    bool check(enet_uint32 host, int now = 0) const;
+    /// drops masks whose expiry time has passed
+    void prune(int now);
+
+private:
+    int insert(enet_uint32 prefix, int len);
+    void index(int i);
+};
   
 #endif
 
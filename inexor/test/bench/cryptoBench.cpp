@@ -0,0 +1,52 @@
+#include "inexor/shared/cube.h"
+
+#include <chrono>
+
+// Times the auth operations the master and game servers run per login:
+// keys from seeds, challenges for a public key and answers to them.
+// Usage: crypto_bench [iterations]
+
+namespace {
+  typedef std::chrono::steady_clock benchclock;
+
+  void report(const char *name, benchclock::time_point start, int n) {
+    double ms = std::chrono::duration<double, std::milli>(benchclock::now() - start).count();
+    printf("%-16s %8d ops %10.2f ms %10.4f ms/op\n", name, n, ms, ms/n);
+  }
+}
+
+int main(int argc, char **argv) {
+  int n = argc > 1 ? max(atoi(argv[1]), 1) : 200;
+  initchallenges();
+
+  vector<char> privkey, pubkey;
+  benchclock::time_point start = benchclock::now();
+  loopi(n) {
+    defformatstring(seed)("bench key %d", i);
+    privkey.setsize(0);
+    pubkey.setsize(0);
+    genprivkey(seed, privkey, pubkey);
+  }
+  report("genprivkey", start, n);
+
+  void *key = parsepubkey(pubkey.getbuf());
+  vector<char> challenge;
+  start = benchclock::now();
+  loopi(n) {
+    defformatstring(seed)("bench challenge %d", i);
+    challenge.setsize(0);
+    freechallenge(genchallenge(key, seed, strlen(seed), challenge));
+  }
+  report("genchallenge", start, n);
+
+  vector<char> answer;
+  start = benchclock::now();
+  loopi(n) {
+    answer.setsize(0);
+    answerchallenge(privkey.getbuf(), challenge.getbuf(), answer);
+  }
+  report("answerchallenge", start, n);
+
+  freepubkey(key);
+  return 0;
+}
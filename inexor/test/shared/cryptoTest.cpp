@@ -0,0 +1,85 @@
+#include "inexor/shared/cube.h"
+
+#include "gtest/gtest.h"
+
+#include "inexor/test/helpers.h"
+
+// Keys, challenges and answers generated by the 16-bit digit
+// implementation, the word-size digits must reproduce them exactly
+namespace {
+  struct authvector {
+    const char *privkey, *pubkey, *challenge, *answer;
+  };
+
+  const authvector authvectors[] = {
+    { "d68819a42015f875a2855e8cb16e7ccb48232d75af7d1b2e", "+52f9f3a18ffba39b78a89dad5e3d21e983ee971e01ee3b5e", "+0db7c0f20ed68ce6746a2746a44727aec5c1317515079e8b", "a54a073ff56681b79d9a1717ffa8a61771cdd338033a9bc0" },
+    { "5b612b10b45f2eacfbb2c1c27349f5b29cf70c2f67bf7271", "-354747228684e61b18e2a3934182fef78cc0a22afbc804b1", "+b8b48ed6a6fc086aa0f863609659ca5ee1d639584db7f785", "489644cfa063a0887ff44855d22f780b7271fd28c3797679" },
+    { "0578bae436537dcc1c420c361d515a1ffa17f294fd941b6f", "+c3f055f103e1d7a361e4a75ba2a55cbe1a335485ef7b4b67", "+35c3e6c9c12d902418397ba9876fcae0e4225dcb6e81a40a", "7d1ec5623393aa189844ea576a5fe4ffb42c0a0c31d400a1" },
+    { "930ad1f33bc498b792ae9e68e4a7e35509d622d063b00daa", "+415efacc9303ae86ece9314e6fce743a74e178d61c44bbb2", "-4b6f54a0115a2cac023cbeaf83581d895175cca1b65f5adf", "f38e582d7fcd0bb987f5f29d2e4d1659639057a2006a543e" },
+    { "1e36a3d9516b74b149c9d9071be1cb32e7f8daf4f9145270", "+ded46c7cf76bc959aca1043fa5ae9d1495114d007516fb35", "-2ee72a7af26a76033307c122b78fe5f3d763aa052887c569", "583b12ee9b8e595bce836fe0ab354c069d8c717f2b064a9d" },
+    { "7f845036654f56d56fb31574494ab3cf0dc2d2f2e6acb1ef", "-23f7029ca5379d26acb9cfad74ab840b16c80d368bae9be0", "+fdd88cc852c0e4cf8a29cab7d7ca27b0bda76f0727518dc0", "48a87ddd57f1fd36c3b45cb7102f0ce50a72205b2a6930d9" },
+    { "36a10fcded8c1ec0eff2d00a0d604691ded0da672d025bcf", "+47ff1cbb090a9c3d686b4717f60c5695981b1c4b0e59f666", "-ade3982a0cfab1cd9572fed8ca305635c989117c347836b0", "c2276fef91a39696734c3b2fc3159b5fda71ef04bfb80fec" },
+    { "87a2ab2f8d653710441e3cfaa38e20bbb4851be72c880a07", "+60df6e3c37d65a57e6633d802cd4b7a74d88c1931e162988", "+4792207fa6b9b648fb9152effac0e3e37aa817b9e4c2dcc0", "a5b3f8dc51749ddb9b32b99ba44d50efc47a512dcb26c34c" },
+    { "9b88b57e673ff714abf0b279d0d27578e8a9db65ce9a98e2", "+198578d1db06257c1cd43016c137af7d9642f59fe36f9327", "+3bbe3a4d047da39e0db12bbc85367b161065e5536526288c", "fbd321adfdc3cef948f915d9d2a9c02853fb50cc45811ed3" },
+    { "0f0d537efabcd7f9cb1aeb87790252a2a7ccf1c5a8c8c690", "+80a78faa0f1daed54a1839eb05a35e5b9a0b578977e6351a", "+b8b4b77270cefa8481379c2d98668d66270ce270f2d53000", "fb192930dc6a75db84c904116a25b18fb2a8effbc9a6b46c" },
+    { "c75c8e8032be6bda259d9a0bd7af96ded20281459f0486d0", "+261a98218478d73e3a788ebce95911865662c2d23c53fe8a", "-f10b4840b08eb31e6f3ac5079ede4c1e88b5bc69a1eef5cf", "4a9f576aa6e77a576f5247f756b701914761d3160a9b255f" },
+    { "9f7fae53d2c30ba27f7a81717d069d4247e51c38aebd4fd8", "+354bcac2817e6e07840b6d162d080d83e2e8c1bf0244177d", "+256fede7438d12e474d07db7d1f282d04b65322eb7b0f6db", "9ec7510d0e19ff8aa255da314265c51c146cfd2b4959b17f" },
+    { "c0261f52f80ca89c21cf13f54b512872176f0dbc6249f3b9", "-613a50ffe46549d3109cb35dc465fcadc3ecbc413efa0e0b", "+39f291265e90d2072ccf4d06532bddaf10c121087205db5e", "acb07e70819c9830691984110a03f4156a260ec6a6bed452" },
+    { "a9fe77f2071781ade6905f3e5aecee6197a5d8124be7b13a", "+cb358faf43765dd38deb38f16b25d747363842f9c62e8587", "+686d2e29befbb89ebc8d74057632c3362d615a6f3d226f11", "316d42f6054a46fec0d51f45eaf324568bb8300d4894f23a" },
+    { "01c70a8b7f33559ee467eb9d9ba9841185e2a10e4a42f08f", "+4604efdba0a1c8bf250ea74eb5a9e31c1950def336a056e4", "+6619b1d4bb4010f65e7d91d1cd111599e84a2afe01bcf5a3", "9ee2f9ba50e6cbaad90fa2f0e0260bc3bc43581ff51b1f3a" },
+    { "42ddfbf309c8aaf4674f01dad83827c36b7338d8554d51e7", "+03ea6032b707754424c6fe1a34d7e561bf83e3e104a429b6", "+2e9e8c363090c3583202a514ab754b4777dffe8ae024d8f4", "21a03a6a234da0da169c0d8f6a113f496804aad56842fc77" },
+    { "cc95ae5ea043207faee95aba8e9032dd4eec608301d8dce7", "-ea3264a7777a5e773902000f8ad74ab1e7c36ed3f7223f8d", "+86d617fcf7a5468675b1b3e17b8c58d546985b6945c3e9c2", "c1398e82b3f51b36ef50c30c9707fe29dd387beab29509d7" },
+    { "0177384bfdf2d6ffb009db51308b545e1dd4235b81e8decd", "+15acc31428f38105439fb4feacc0ab0c2da47467ae98b93d", "-8b18876cc37e328ee56317adea2c70ea59046bb445fe5fe3", "f5686c92380f97c5e1dd50ddf0916c1889f229571e146aa9" },
+    { "16e7788ac6f7b2d553c96d2512cfd4b41138e74c7d151770", "+1e1c6b1410a0bed66b039585fc6cbcfcce969c9435ad8209", "+547eb87b348e48446794cd3037fc8f94c75fc6f1b74d4256", "7cbc441c13b18931a625eaff97f810757975c5c7ff48a88f" },
+    { "991bc79c3284b4c6d5fa39f9a5610e84e3f4dc94f89f745e", "-77e84f2c1fa75c77b35d6d03a7692db4f3b1841502f928b0", "-b4a039cb8b4b8a2baca26ef7bf8468361809ce08be80783a", "2a31c7e95253da52ca045806bc81852056f13d26598d2b76" },
+    { "1cd3ddcc85e35bdd3371c195560343ca9f4feab0f11aec48", "-d8e1803690e444a0db31d2ddac1772be6379b5975de757c1", "+e5874206d38b6cfc25d96c7a2f63fc2e8d17b767019048f1", "70f19bfac5318ce2e0c06a91fd61636413eb7072d222872c" },
+    { "17c5fef6502391c88f1adc505f3d8b3aab77eb1c1b7d9dfd", "+44bef83599c13ae71b9d9c241f3370a2ee6f672023b6a589", "+e0df38850c84ecbcd2805f12862bddc4f8614ec3211f950c", "f9f5cac2c2aea38009fe32fc0eef9e867eb9f46e9631da83" },
+    { "f1df3bb6429e1dd8ee6905b5a5435ae965dce8e2c73b7235", "+a80a8dd5dd46d34990a4d1a546051660a8afea47b42edb6b", "+7b086aa91c4487b04e15d5b38f7022996312f1a9842ec65d", "522eb0ae0c0cbb0fc6fb5f011c06a4ba0a77d9ad86869f43" },
+    { "5e9e3fa7527ba5143ee2c28f01a40d31609864e691be359c", "-e7d475aff6f8726f794df7b291603b1e1fa9a2d8e8397795", "+998836fcc20e9a405a7a719497917024a65e6e4a98282b0f", "4049c16a070211ac1a65e83e61531a74617e2d2f053e2ab4" },
+    { "41f1f373255f5c2c65d087008c1b4484b5a161ba0a79387c", "-ef91014a5143892c911f1f3ad63d21bec416a85e0e4dc9d4", "-a0997c0cfb5d0b5fe830955884e1daff3344d33cc3a7d708", "b0d4d32916ed03ccdfc82e29c06dd3f96dd54463ce94c4d7" },
+    { "26f17ea101cf51f6202adf4c11cde2eddf92abe1ac8ff6ea", "-03a22eafebb542cf53244470d8ca7010f950c6c6a7337110", "-d6e0cb8b9184af1e6883dd564d7960be24227c338c410480", "6aca99352179ef977478c536dbe9bffc76af16bedd3ed75b" },
+    { "ef7d99646dad4ef01427d911d005b6a6b2b03cdac3c0e4ce", "-d4d795c9893143788359036e3e0b2b00624d8d2051007cbd", "-8d7453efbc498f02cd569f003cb97b0a137b390969380884", "832a7bda6c37fbd0e23ed62623e210bdb7becb1d89c494fe" },
+    { "35d241ef4c3c7e43306b0823b76ac395235c4cc693c0dc1e", "+a484ba343981778af286bf767f3dcc702a511eb70403e788", "+73731aec425f4a9660dabdd405003f0e14e9189a0256b285", "6d5250aad5823638dff13648af1a0aec175f85d40ae37153" },
+    { "143fe1e025f4a38dae0db0caa3020cf49584e8afc6c0170b", "+68df5d1e08f8324314a89bf3463cdcb9b947016de2bb453b", "+695da0b177686fcac7c8cf0ddfd3170d31ad5f3f0c9c0e51", "3f6fb8310d5668f778b2e528f82c64e265c17ec47f4ee94d" },
+    { "ae0b87a0bf6732166662f642493a43117b4017ac38e91483", "-14f444f79e0539f48946ec942d0a1e4b3d62c673e8136157", "-cc32b3b159295073ef07483b84b56c547f91812427490090", "2d0292146d2a8aaa145299486ae90757478c677f8386d655" },
+    { "a2bf5903d2c30de66e012c574f6364332a9f77e6b38f243d", "-d1b26719ca6bcac85ab4ca7904a80a06b9a3a5c9f022b16e", "+a985d0a72cd4b1df6303526f1e4451e05fe4c5db9ea6b682", "447e718834598db6195875dba307eaa5df13a1724cbc3fdc" },
+    { "9d6e4c6e3e7a523b6b30a78b7ff34156ebdfdfd07b9b6d57", "-c226e65fd70e45d5d58363e7e94fdd62c51006765e25cbc5", "-11363edce47ed4c07c3fad8912319e2784007cb11b978f58", "c9e34fc0cb6d007ceb09a15ef0084b7b9221138b9edad430" },
+    { "cc1aab79d35423602825288bbc4871893d9ac01fffae07bb", "+49f28269837406e676b6dda4112338e673e45ee4a5054793", "+09fd38681f8aed72d3049272aea796ce81bfc5daa4415b2f", "742dd34a6a691d9e0787408e3010eaee3dc2c4a9d10631a0" },
+    { "cee534d5bb271d0baacd17e386d78d688e0be3d1e9647431", "+0cc67415e23fc1e2f9aa24ea7e96b1ee8d55502002445c2b", "-15f6807d8ff2d4dfcd0281ac3726ba5278aa598668c7457a", "91c3e8bbe5eacefe5640838195bee7c39485a3211cd210e6" },
+    { "7f80b6088bbeb7dde9538f2bc91381a4d57a616b31f356d5", "-680ab2718279eec4c31d781aa92476c3c99a27b4f6cf59d0", "+43a94861a46b6dbf2a16777ce36cdcaffc9cba74fccec35f", "c4251a7c65e8fb106298c1a4fac2080382408bd6799f7578" },
+    { "78230666d8019d41d0deeaa04b5d3f3e6e1f51af226911a1", "+3090ed6af96a8c63ea6dae1c3c590485ab24abf84ac2fcd3", "+f19c3531432ed9b77e80526f04f7a200a482f77faccb1dc9", "46796fb4a5f6312af0993205b4eac80827ab777330838e85" },
+    { "612d9c98f3e63ea78f0882740df2165a34267d843339eaf6", "+d4d71fd0ade9b78925799e98f3d563532a4d7aa43193fee9", "+b538efc26c5f8bf582dacd2df636b7e966bf6f7c93ce6e8d", "d8ff7d0eb58290473979f71b4df9fbddaecce387c230cfbb" },
+    { "7b4bb92609250abbeeacc525ed3ab0aea3ecc6139136f4b9", "+3477e2275138491fadfe17af90a30333150c4c7370f6dccb", "+40f2d29922f680b2db051d3c3ddb5b074ed75cccf30b7b89", "75d6e481436b6dc358513a6645368a3f0b3a865fb3fa45b2" },
+    { "65528289fb04fa162609014ea148ab245b28d4aa92845d57", "+15fabf9f827db956eee98f2955d2750e12661ef807827aae", "-b5deea77517905bb98a3fc62beac8d77bdf59724e572c81c", "a8c8c726cec92fe61b1deb7730764f1181366f396a5841ea" },
+    { "a1e3f8143abf49dc27d91f4452449488c07b4afad304c72d", "-dc3146b71448cd2f9ee72f4f01db8516b0683ef75e1f4d56", "+2aee0043d46fae2d6be6b8ec3de715d465e93e95d5529ad6", "5992c1d2efd49fc9f89717b2af076ad8870daedcfd05ff3b" },
+  };
+  const int numauthvectors = sizeof(authvectors)/sizeof(authvectors[0]);
+
+  test(crypto, KeysFromSeeds) {
+    loopi(numauthvectors) {
+      defformatstring(seed)("inexor test key %d", i);
+      vector<char> privkey, pubkey;
+      genprivkey(seed, privkey, pubkey);
+      expectEq(std::string(authvectors[i].privkey), privkey.getbuf()) << "private key of seed " << i;
+      expectEq(std::string(authvectors[i].pubkey), pubkey.getbuf()) << "public key of seed " << i;
+    }
+  }
+
+  test(crypto, ChallengesAndAnswers) {
+    initchallenges();
+    loopi(numauthvectors) {
+      const authvector &v = authvectors[i];
+      defformatstring(seed)("challenge %d", i);
+      void *pubkey = parsepubkey(v.pubkey);
+      vector<char> challenge, answer;
+      void *correct = genchallenge(pubkey, seed, strlen(seed), challenge);
+      expectEq(std::string(v.challenge), challenge.getbuf()) << "challenge of seed " << i;
+      answerchallenge(v.privkey, v.challenge, answer);
+      expectEq(std::string(v.answer), answer.getbuf()) << "answer of seed " << i;
+      expect(checkchallenge(v.answer, correct)) << "check of seed " << i;
+      expect(!checkchallenge(authvectors[(i+1)%numauthvectors].answer, correct)) << "wrong answer accepted for seed " << i;
+      freechallenge(correct);
+      freepubkey(pubkey);
+    }
+  }
+}